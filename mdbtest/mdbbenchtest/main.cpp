@@ -0,0 +1,280 @@
+#include <QtTest>
+#include <QtSql>
+
+#include <mdbtools.h>
+
+// Benchmarks of the QMDBTOOLS driver.
+//
+// The database is taken from QMDBTOOLS_BENCH_DB (default Books_be.mdb) and the
+// scanned table from QMDBTOOLS_BENCH_TABLE (default the largest user table).
+// Large fixtures are produced by mdbfixturegen, e.g.
+//     mdbfixturegen Books_be.mdb big.mdb Books 5000000
+// Use the QtTest output options for machine-readable results, e.g.
+//     QMDBTOOLS_BENCH_DB=big.mdb mdbbenchtest -o bench.xml,xml
+// Scans additionally report their throughput in rows/sec as an info message.
+
+class MdbBenchTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void openLatency();
+    void tablesLatency();
+    void recordLatency();
+    void scanByType_data();
+    void scanByType();
+    void wideProjection_data();
+    void wideProjection();
+    void oleScan();
+    void forwardFetch();
+    void randomSeek();
+
+private:
+    int scan(const QString &sql, bool forwardOnly = true);
+    void reportRowRate(qint64 rows, const QElapsedTimer &timer);
+
+    QString m_dbName;
+    QString m_table;
+    QSqlRecord m_record;
+};
+
+static const QLatin1String connName("mdbbench");
+
+static QString typeName(int mdbType) {
+    switch (mdbType) {
+    case MDB_BOOL:     return "BOOL";
+    case MDB_BYTE:     return "BYTE";
+    case MDB_INT:      return "INT";
+    case MDB_LONGINT:  return "LONGINT";
+    case MDB_MONEY:    return "MONEY";
+    case MDB_FLOAT:    return "FLOAT";
+    case MDB_DOUBLE:   return "DOUBLE";
+    case MDB_DATETIME: return "DATETIME";
+    case MDB_BINARY:   return "BINARY";
+    case MDB_TEXT:     return "TEXT";
+    case MDB_OLE:      return "OLE";
+    case MDB_MEMO:     return "MEMO";
+    case MDB_REPID:    return "REPID";
+    case MDB_NUMERIC:  return "NUMERIC";
+    case MDB_COMPLEX:  return "COMPLEX";
+    }
+    return "Unknown";
+}
+
+void MdbBenchTest::initTestCase()
+{
+    m_dbName = qEnvironmentVariable("QMDBTOOLS_BENCH_DB", "Books_be.mdb");
+    if (!QFile::exists(m_dbName))
+        QSKIP(qPrintable(QString("Fixture %1 not found").arg(m_dbName)));
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QMDBTOOLS", connName);
+    db.setDatabaseName(m_dbName);
+    QVERIFY2(db.open(), qPrintable(db.lastError().text()));
+
+    m_table = qEnvironmentVariable("QMDBTOOLS_BENCH_TABLE");
+    if (m_table.isEmpty()) {
+        int maxRows = -1;
+        const auto tables = db.tables();
+        for (const auto &table : tables) {
+            QSqlQuery query(db);
+            query.setForwardOnly(true);
+            if (query.exec(QString("select * from %1").arg(table)) && query.size() > maxRows) {
+                maxRows = query.size();
+                m_table = table;
+            }
+        }
+    }
+    QVERIFY(!m_table.isEmpty());
+    m_record = db.record(m_table);
+    QVERIFY(!m_record.isEmpty());
+    qInfo() << "Fixture" << m_dbName << "table" << m_table << "columns" << m_record.count();
+}
+
+void MdbBenchTest::cleanupTestCase()
+{
+    QSqlDatabase::database(connName, false).close();
+    QSqlDatabase::removeDatabase(connName);
+}
+
+int MdbBenchTest::scan(const QString &sql, bool forwardOnly)
+{
+    QSqlQuery query(QSqlDatabase::database(connName));
+    query.setForwardOnly(forwardOnly);
+    if (!query.exec(sql))
+        return -1;
+    const int colCount = query.record().count();
+    int rows = 0;
+    while (query.next()) {
+        for (int i = 0; i < colCount; ++i)
+            query.value(i);
+        ++rows;
+    }
+    return rows;
+}
+
+// Reports the rows read per second over all iterations of a QBENCHMARK loop
+void MdbBenchTest::reportRowRate(qint64 rows, const QElapsedTimer &timer)
+{
+    const qint64 nsecs = timer.nsecsElapsed();
+    if (rows <= 0 || nsecs <= 0)
+        return;
+    qInfo("%s: %.0f rows/sec", QTest::currentDataTag() ? QTest::currentDataTag() : QTest::currentTestFunction(),
+          double(rows) * 1e9 / double(nsecs));
+}
+
+void MdbBenchTest::openLatency()
+{
+    QBENCHMARK {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QMDBTOOLS", "mdbbench-open");
+        db.setDatabaseName(m_dbName);
+        QVERIFY(db.open());
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase("mdbbench-open");
+    }
+}
+
+void MdbBenchTest::tablesLatency()
+{
+    QSqlDatabase db = QSqlDatabase::database(connName);
+    QBENCHMARK {
+        QVERIFY(!db.tables().isEmpty());
+    }
+}
+
+void MdbBenchTest::recordLatency()
+{
+    QSqlDatabase db = QSqlDatabase::database(connName);
+    QBENCHMARK {
+        QVERIFY(!db.record(m_table).isEmpty());
+    }
+}
+
+void MdbBenchTest::scanByType_data()
+{
+    QTest::addColumn<QString>("column");
+
+    QSet<QString> types;
+    for (int i = 0; i < m_record.count(); ++i) {
+        const QSqlField fld = m_record.field(i);
+        const QString type = typeName(fld.typeID());
+        if (types.contains(type))
+            continue;
+        types << type;
+        QTest::newRow(qPrintable(type)) << fld.name();
+    }
+}
+
+void MdbBenchTest::scanByType()
+{
+    QFETCH(QString, column);
+    const QString sql = QString("select %1 from %2").arg(column, m_table);
+    int rows = 0;
+    qint64 totalRows = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        rows = scan(sql);
+        totalRows += rows;
+    }
+    QVERIFY(rows >= 0);
+    reportRowRate(totalRows, timer);
+}
+
+void MdbBenchTest::wideProjection_data()
+{
+    QTest::addColumn<QString>("columns");
+
+    QTest::newRow("one") << m_record.fieldName(0);
+    QStringList half;
+    for (int i = 0; i < m_record.count(); i += 2)
+        half << m_record.fieldName(i);
+    QTest::newRow("half") << half.join(", ");
+    QTest::newRow("all") << QString("*");
+}
+
+void MdbBenchTest::wideProjection()
+{
+    QFETCH(QString, columns);
+    const QString sql = QString("select %1 from %2").arg(columns, m_table);
+    int rows = 0;
+    qint64 totalRows = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        rows = scan(sql);
+        totalRows += rows;
+    }
+    QVERIFY(rows >= 0);
+    reportRowRate(totalRows, timer);
+}
+
+void MdbBenchTest::oleScan()
+{
+    QStringList columns;
+    for (int i = 0; i < m_record.count(); ++i) {
+        const int type = m_record.field(i).typeID();
+        if (type == MDB_OLE || type == MDB_MEMO)
+            columns << m_record.fieldName(i);
+    }
+    if (columns.isEmpty())
+        QSKIP("Table has no OLE or MEMO columns");
+
+    const QString sql = QString("select %1 from %2").arg(columns.join(", "), m_table);
+    int rows = 0;
+    qint64 totalRows = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        rows = scan(sql);
+        totalRows += rows;
+    }
+    QVERIFY(rows >= 0);
+    reportRowRate(totalRows, timer);
+}
+
+void MdbBenchTest::forwardFetch()
+{
+    QSqlQuery query(QSqlDatabase::database(connName));
+    query.setForwardOnly(true);
+    QVERIFY(query.exec(QString("select * from %1").arg(m_table)));
+    qint64 rows = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        while (query.next()) {
+            query.value(0);
+            ++rows;
+        }
+    }
+    reportRowRate(rows, timer);
+}
+
+void MdbBenchTest::randomSeek()
+{
+    QSqlQuery query(QSqlDatabase::database(connName));
+    QVERIFY(query.exec(QString("select * from %1").arg(m_table)));
+    const int size = query.size();
+    if (size <= 0)
+        QSKIP("Table is empty");
+
+    QRandomGenerator rnd(42);
+    qint64 rows = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            QVERIFY(query.seek(rnd.bounded(size)));
+            query.value(0);
+        }
+        rows += 1000;
+    }
+    reportRowRate(rows, timer);
+}
+
+QTEST_GUILESS_MAIN(MdbBenchTest)
+
+#include "main.moc"
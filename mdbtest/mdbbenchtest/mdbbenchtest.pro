@@ -0,0 +1,23 @@
+QT -= gui
+QT += sql testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = mdbbenchtest
+
+# to find file glib.h
+INCLUDEPATH += /usr/include/glib-2.0
+
+# to find file glibconfig.h
+INCLUDEPATH += /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+SOURCES += \
+        main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+DISTFILES += ../mdbdrivertest/Books_be.mdb
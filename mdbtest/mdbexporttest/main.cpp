@@ -0,0 +1,423 @@
+#include <QtTest>
+#include <QtSql>
+
+#include <mdbtools.h>
+
+#include "qmdbtoolsexport_p.h"
+
+// Round trip of the Arrow IPC export.
+//
+// Every user table of the fixture is exported to an Arrow stream file, the file is
+// parsed back and its schema and values are compared with the rows the QMDBTOOLS
+// driver returns for the table. The fixture is taken from QMDBTOOLS_TEST_DB
+// (default Books_be.mdb of mdbdrivertest).
+
+// Arrow IPC constants, see Schema.fbs and Message.fbs of the Arrow format
+enum ArrowType { ArrowInt = 2, ArrowFloatingPoint = 3, ArrowBinary = 4, ArrowUtf8 = 5,
+                 ArrowBool = 6, ArrowTimestamp = 10 };
+enum ArrowHeader { ArrowSchemaHeader = 1, ArrowRecordBatchHeader = 3 };
+
+// Read access to a FlatBuffers encoded Arrow message; out of range reads return 0
+// and clear ok
+class FlatBuffer
+{
+public:
+    explicit FlatBuffer(const QByteArray &data) : m_data(data) {}
+
+    bool ok() const { return m_ok; }
+    int root() { return offset(0); }
+
+    quint64 scalar(int table, int id, int size) {
+        const int pos = field(table, id);
+        if (!pos)
+            return 0;
+        switch (size) {
+        case 1: return read<quint8>(pos);
+        case 2: return read<quint16>(pos);
+        case 4: return read<quint32>(pos);
+        }
+        return read<quint64>(pos);
+    }
+    int table(int table, int id) {
+        const int pos = field(table, id);
+        return pos ? offset(pos) : 0;
+    }
+    QByteArray string(int table, int id) {
+        const int pos = this->table(table, id);
+        const int size = pos ? int(read<quint32>(pos)) : 0;
+        if (!inside(pos + 4, size))
+            return QByteArray();
+        return m_data.mid(pos + 4, size);
+    }
+    // returns the position of the first element and its count
+    int vector(int table, int id, int *count) {
+        const int pos = this->table(table, id);
+        *count = pos ? int(read<quint32>(pos)) : 0;
+        return pos + 4;
+    }
+    int tableAt(int vector, int index) {
+        return offset(vector + 4 * index);
+    }
+    template <typename T>
+    T read(int pos) {
+        if (!inside(pos, int(sizeof(T))))
+            return T(0);
+        return qFromLittleEndian<T>(m_data.constData() + pos);
+    }
+
+private:
+    bool inside(int pos, int size) {
+        if (pos >= 0 && size >= 0 && pos <= m_data.size() - size)
+            return true;
+        m_ok = false;
+        return false;
+    }
+    int offset(int pos) {
+        return pos + int(read<quint32>(pos));
+    }
+    // position of field id of the table at pos, 0 if the field is not present
+    int field(int pos, int id) {
+        const int vtable = pos - read<qint32>(pos);
+        const int vtableSize = read<quint16>(vtable);
+        if (4 + 2 * id >= vtableSize)
+            return 0;
+        const int at = read<quint16>(vtable + 4 + 2 * id);
+        return at ? pos + at : 0;
+    }
+
+    QByteArray m_data;
+    bool m_ok = true;
+};
+
+struct ArrowColumn
+{
+    QString name;
+    int type = 0;
+    int bitWidth = 0;        ///< Int
+    int precision = 0;       ///< FloatingPoint, 1 is single and 2 double
+    QVariantList values;
+};
+
+// Reads an Arrow IPC stream into columns of QVariant values, null values are invalid variants
+class ArrowStreamReader
+{
+public:
+    bool read(const QByteArray &data);
+    QString errorString() const { return m_error; }
+
+    QVector<ArrowColumn> columns;
+
+private:
+    bool readSchema(FlatBuffer &meta, int header);
+    bool readBatch(FlatBuffer &meta, int header, const QByteArray &body);
+    bool fail(const QString &error) {
+        m_error = error;
+        return false;
+    }
+
+    QString m_error;
+};
+
+bool ArrowStreamReader::read(const QByteArray &data)
+{
+    bool hasSchema = false;
+    qint64 pos = 0;
+    forever {
+        if (pos + 8 > data.size())
+            return fail(QString("Stream ends without end-of-stream marker at %1").arg(pos));
+        if (qFromLittleEndian<quint32>(data.constData() + pos) != 0xffffffff)
+            return fail(QString("Missing continuation marker at %1").arg(pos));
+        const qint32 metaSize = qFromLittleEndian<qint32>(data.constData() + pos + 4);
+        pos += 8;
+        if (metaSize == 0)
+            break;
+        if (metaSize < 0 || metaSize % 8 || pos + metaSize > data.size())
+            return fail(QString("Bad metadata size %1 at %2").arg(metaSize).arg(pos));
+
+        FlatBuffer meta(data.mid(int(pos), metaSize));
+        pos += metaSize;
+        const int message = meta.root();
+        const int version = int(meta.scalar(message, 0, 2));
+        const int headerType = int(meta.scalar(message, 1, 1));
+        const int header = meta.table(message, 2);
+        const qint64 bodyLength = qint64(meta.scalar(message, 3, 8));
+        if (!meta.ok() || version != 4)
+            return fail(QString("Bad message at %1").arg(pos));
+        if (bodyLength < 0 || bodyLength % 8 || pos + bodyLength > data.size())
+            return fail(QString("Bad body length %1 at %2").arg(bodyLength).arg(pos));
+        const QByteArray body = data.mid(int(pos), int(bodyLength));
+        pos += bodyLength;
+
+        if (headerType == ArrowSchemaHeader) {
+            if (hasSchema || !readSchema(meta, header))
+                return fail(QString("Bad schema message"));
+            hasSchema = true;
+        } else if (headerType == ArrowRecordBatchHeader) {
+            if (!hasSchema)
+                return fail(QString("Record batch before schema"));
+            if (!readBatch(meta, header, body))
+                return m_error.isEmpty() ? fail(QString("Bad record batch message")) : false;
+        } else {
+            return fail(QString("Unexpected message type %1").arg(headerType));
+        }
+    }
+    if (pos != data.size())
+        return fail(QString("%1 bytes after end-of-stream marker").arg(data.size() - pos));
+    return hasSchema;
+}
+
+bool ArrowStreamReader::readSchema(FlatBuffer &meta, int header)
+{
+    int count = 0;
+    const int fields = meta.vector(header, 1, &count);
+    for (int i = 0; i < count && meta.ok(); ++i) {
+        const int field = meta.tableAt(fields, i);
+        ArrowColumn column;
+        column.name = QString::fromUtf8(meta.string(field, 0));
+        column.type = int(meta.scalar(field, 2, 1));
+        const int type = meta.table(field, 3);
+        if (column.type == ArrowInt)
+            column.bitWidth = int(meta.scalar(type, 0, 4));
+        else if (column.type == ArrowFloatingPoint)
+            column.precision = int(meta.scalar(type, 0, 2));
+        columns << column;
+    }
+    return meta.ok();
+}
+
+bool ArrowStreamReader::readBatch(FlatBuffer &meta, int header, const QByteArray &body)
+{
+    const qint64 length = qint64(meta.scalar(header, 0, 8));
+    int nodeCount = 0, bufferCount = 0;
+    const int nodes = meta.vector(header, 1, &nodeCount);
+    const int buffers = meta.vector(header, 2, &bufferCount);
+    if (!meta.ok() || nodeCount != columns.size())
+        return false;
+
+    int b = 0;
+    auto nextBuffer = [&]() {
+        const qint64 offset = meta.read<qint64>(buffers + 16 * b);
+        const qint64 size = meta.read<qint64>(buffers + 16 * b + 8);
+        ++b;
+        if (b > bufferCount || offset < 0 || size < 0 || offset + size > body.size()) {
+            m_error = QString("Buffer %1 outside of the body").arg(b - 1);
+            return QByteArray();
+        }
+        return body.mid(int(offset), int(size));
+    };
+
+    for (int c = 0; c < columns.size(); ++c) {
+        ArrowColumn &column = columns[c];
+        if (meta.read<qint64>(nodes + 16 * c) != length)
+            return fail(QString("Column %1 has a different length").arg(column.name));
+        const QByteArray validity = nextBuffer();
+        QByteArray offsets;
+        if (column.type == ArrowUtf8 || column.type == ArrowBinary)
+            offsets = nextBuffer();
+        const QByteArray values = nextBuffer();
+        if (!m_error.isEmpty())
+            return false;
+
+        auto bit = [](const QByteArray &bits, qint64 row) {
+            return (bits.at(int(row >> 3)) >> (row & 7)) & 1;
+        };
+        int width = 0;
+        switch (column.type) {
+        case ArrowBool:
+            width = 0;
+            break;
+        case ArrowInt:
+            width = column.bitWidth / 8;
+            break;
+        case ArrowFloatingPoint:
+            width = column.precision == 1 ? 4 : 8;
+            break;
+        case ArrowTimestamp:
+            width = 8;
+            break;
+        case ArrowUtf8:
+        case ArrowBinary:
+            if (offsets.size() < (length + 1) * 4)
+                return fail(QString("Column %1 has too few offsets").arg(column.name));
+            break;
+        default:
+            return fail(QString("Column %1 has unexpected type %2").arg(column.name).arg(column.type));
+        }
+        if (values.size() < (width ? length * width : (length + 7) / 8)
+                || (!validity.isEmpty() && validity.size() < (length + 7) / 8))
+            return fail(QString("Column %1 has too few values").arg(column.name));
+
+        const char *value = values.constData();
+        for (qint64 r = 0; r < length; ++r) {
+            if (!validity.isEmpty() && !bit(validity, r)) {
+                column.values << QVariant();
+                continue;
+            }
+            switch (column.type) {
+            case ArrowBool:
+                column.values << bool(bit(values, r));
+                break;
+            case ArrowInt:
+                if (width == 1)
+                    column.values << qlonglong(quint8(value[r]));
+                else if (width == 2)
+                    column.values << qlonglong(qFromLittleEndian<qint16>(value + r * 2));
+                else
+                    column.values << qlonglong(qFromLittleEndian<qint32>(value + r * 4));
+                break;
+            case ArrowFloatingPoint:
+                if (width == 4)
+                    column.values << double(qFromLittleEndian<float>(value + r * 4));
+                else
+                    column.values << qFromLittleEndian<double>(value + r * 8);
+                break;
+            case ArrowTimestamp:
+                column.values << QDateTime::fromMSecsSinceEpoch(qFromLittleEndian<qint64>(value + r * 8), Qt::UTC);
+                break;
+            default: {
+                const qint32 start = qFromLittleEndian<qint32>(offsets.constData() + r * 4);
+                const qint32 end = qFromLittleEndian<qint32>(offsets.constData() + r * 4 + 4);
+                if (start < 0 || end < start || end > values.size())
+                    return fail(QString("Column %1 has bad offsets").arg(column.name));
+                const QByteArray bytes = values.mid(start, end - start);
+                if (column.type == ArrowUtf8)
+                    column.values << QString::fromUtf8(bytes);
+                else
+                    column.values << bytes;
+                break;
+            }
+            }
+        }
+    }
+    return b == bufferCount;
+}
+
+class MdbExportTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void arrowRoundTrip_data();
+    void arrowRoundTrip();
+
+private:
+    QString m_dbName;
+    MdbHandle *m_mdb = nullptr;
+    QTemporaryDir m_dir;
+};
+
+static const QLatin1String connName("mdbexport");
+
+void MdbExportTest::initTestCase()
+{
+    m_dbName = qEnvironmentVariable("QMDBTOOLS_TEST_DB", QFINDTESTDATA("../mdbdrivertest/Books_be.mdb"));
+    if (!QFile::exists(m_dbName))
+        QSKIP(qPrintable(QString("Fixture %1 not found").arg(m_dbName)));
+    QVERIFY(m_dir.isValid());
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QMDBTOOLS", connName);
+    db.setDatabaseName(m_dbName);
+    QVERIFY2(db.open(), qPrintable(db.lastError().text()));
+
+    m_mdb = mdb_open(qPrintable(m_dbName), MDB_NOFLAGS);
+    QVERIFY(m_mdb);
+    QVERIFY(mdb_read_catalog(m_mdb, MDB_TABLE));
+}
+
+void MdbExportTest::cleanupTestCase()
+{
+    if (m_mdb)
+        mdb_close(m_mdb);
+    QSqlDatabase::database(connName, false).close();
+    QSqlDatabase::removeDatabase(connName);
+}
+
+void MdbExportTest::arrowRoundTrip_data()
+{
+    QTest::addColumn<QString>("table");
+
+    const auto tables = QSqlDatabase::database(connName).tables();
+    for (const auto &table : tables)
+        QTest::newRow(qPrintable(table)) << table;
+}
+
+void MdbExportTest::arrowRoundTrip()
+{
+    QFETCH(QString, table);
+
+    const QString fileName = m_dir.filePath(table + ".arrows");
+    QString error;
+    QVERIFY2(QMdbToolsExporter::exportTable(m_mdb, table, fileName, QMdbToolsExporter::ArrowFormat,
+                                            nullptr, &error), qPrintable(error));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    ArrowStreamReader reader;
+    QVERIFY2(reader.read(file.readAll()), qPrintable(reader.errorString()));
+
+    const QSqlRecord record = QSqlDatabase::database(connName).record(table);
+    QCOMPARE(reader.columns.size(), record.count());
+    for (int c = 0; c < record.count(); ++c)
+        QCOMPARE(reader.columns.at(c).name, record.fieldName(c));
+
+    QSqlQuery query(QSqlDatabase::database(connName));
+    query.setForwardOnly(true);
+    QVERIFY2(query.exec(QString("select * from %1").arg(table)), qPrintable(query.lastError().text()));
+    int row = 0;
+    while (query.next()) {
+        for (int c = 0; c < record.count(); ++c) {
+            const ArrowColumn &column = reader.columns.at(c);
+            QVERIFY2(row < column.values.size(), qPrintable(column.name));
+            const QVariant actual = column.values.at(row);
+            const QVariant expected = query.value(c);
+            const QByteArray where = QString("row %1 column %2").arg(row).arg(column.name).toUtf8();
+            // OLE values are converted to text by the driver
+            if (column.type == ArrowBinary)
+                continue;
+            // text libmdb converts into a bound buffer is empty rather than null
+            if (column.type == ArrowUtf8) {
+                QCOMPARE(actual.toString(), expected.toString());
+                continue;
+            }
+            QVERIFY2(actual.isNull() == expected.isNull(), where.constData());
+            if (actual.isNull())
+                continue;
+            switch (column.type) {
+            case ArrowBool:
+                QCOMPARE(actual.toBool(), expected.toBool());
+                break;
+            case ArrowInt:
+                QCOMPARE(actual.toLongLong(), expected.toLongLong());
+                break;
+            case ArrowFloatingPoint:
+                if (column.precision == 1)
+                    QCOMPARE(float(actual.toDouble()), expected.toFloat());
+                else
+                    QCOMPARE(actual.toDouble(), expected.toDouble());
+                break;
+            case ArrowTimestamp: {
+                // the driver returns the local date and time of the value, truncated to seconds
+                const QDateTime exported = actual.toDateTime();
+                if (expected.type() == QVariant::Date) {
+                    QCOMPARE(exported.date(), expected.toDate());
+                } else {
+                    const QDateTime read = expected.toDateTime();
+                    const QDateTime utc(read.date(), read.time(), Qt::UTC);
+                    QVERIFY2(qAbs(exported.msecsTo(utc)) < 1000, where.constData());
+                }
+                break;
+            }
+            }
+        }
+        ++row;
+    }
+    for (const auto &column : qAsConst(reader.columns))
+        QCOMPARE(column.values.size(), row);
+}
+
+QTEST_GUILESS_MAIN(MdbExportTest)
+
+#include "main.moc"
@@ -0,0 +1,36 @@
+QT -= gui
+QT += sql testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = mdbexporttest
+
+# to find file glib.h
+INCLUDEPATH += /usr/include/glib-2.0
+
+# to find file glibconfig.h
+INCLUDEPATH += /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+# the exporter is built into the test, the driver plugin does not export it
+INCLUDEPATH += ../../mdbtools
+
+HEADERS += \
+    ../../mdbtools/qmdbtoolsexport_p.h \
+    ../../mdbtools/qmdbtoolspagedecoder_p.h \
+    ../../mdbtools/qmdbtoolstablescan_p.h
+
+SOURCES += \
+        main.cpp \
+        ../../mdbtools/qmdbtoolsexport.cpp \
+        ../../mdbtools/qmdbtoolspagedecoder.cpp \
+        ../../mdbtools/qmdbtoolstablescan.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+DISTFILES += ../mdbdrivertest/Books_be.mdb
+
+unix:!macx: LIBS += -lmdb -lglib-2.0
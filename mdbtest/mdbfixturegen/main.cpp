@@ -0,0 +1,321 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QtEndian>
+
+#include <mdbtools.h>
+
+#include "qmdbtoolspagedecoder_p.h"
+
+#include <cstring>
+
+#include <QDebug>
+
+// Page types and limits of the Jet page format
+static const int DataPageType   = 0x01;
+static const int UsageMapType   = 0x05;
+static const int MaxRowsPerPage = 255;
+
+// Raw field values of a row copied out of the page buffer
+struct SeedRow {
+    QVector<QByteArray> values;
+    QVector<bool> nulls;
+};
+
+MdbTableDef *tableDef(MdbHandle *mdb, const QString &tableName) {
+    auto table = mdb_read_table_by_name(mdb, const_cast<char *>(qUtf8Printable(tableName)), MDB_TABLE);
+    if (!table) {
+        qDebug() << QString("Error: Table %1 does not exist in this database.").arg(tableName);
+        return table;
+    }
+
+    /* read table */
+    mdb_read_columns(table);
+    mdb_rewind_table(table);
+
+    return table;
+}
+
+QList<SeedRow> seedRows(MdbTableDef *table) {
+    MdbHandle *mdb = table->entry->mdb;
+    QList<SeedRow> rows;
+    QVector<MdbField> fields(table->num_cols);
+
+    mdb_rewind_table(table);
+    while (mdb_read_next_dpg(table)) {
+        int rowCount = mdb_get_int16(mdb->pg_buf, mdb->fmt->row_count_offset);
+        for (int r = 0; r < rowCount; ++r) {
+            int rowStart = 0;
+            size_t rowSize = 0;
+            if (mdb_find_row(mdb, r, &rowStart, &rowSize))
+                continue;
+            // rows with the lookup flag are live, libmdb reads them as well
+            if (QMdbToolsPageDecoder::isDeletedRow(rowStart))
+                continue;
+            rowStart = QMdbToolsPageDecoder::rowStart(rowStart);
+            int numFields = mdb_crack_row(table, mdb->pg_buf + rowStart, rowSize, fields.data());
+            SeedRow row;
+            for (int i = 0; i < numFields; ++i) {
+                row.nulls << bool(fields[i].is_null);
+                row.values << QByteArray(static_cast<const char *>(fields[i].value), fields[i].siz);
+            }
+            rows << row;
+        }
+    }
+    mdb_rewind_table(table);
+    return rows;
+}
+
+// Makes fixed-width numeric columns differ from row to row (time-ordered dates, ascending ids)
+void varyValue(MdbColumn *col, QByteArray &value, qint64 rowNum) {
+    switch (col->col_type) {
+    case MDB_INT:
+        if (value.size() == 2)
+            qToLittleEndian<qint16>(qint16(rowNum % 32768), value.data());
+        break;
+    case MDB_LONGINT:
+        if (value.size() == 4)
+            qToLittleEndian<qint32>(qint32(rowNum), value.data());
+        break;
+    case MDB_DOUBLE:
+        if (value.size() == 8)
+            qToLittleEndian<double>(double(rowNum) / 7.0, value.data());
+        break;
+    case MDB_DATETIME:
+        // days since 1899-12-30, one row per minute starting at 2000-01-01
+        if (value.size() == 8)
+            qToLittleEndian<double>(36526.0 + double(rowNum) / 1440.0, value.data());
+        break;
+    default:
+        break;
+    }
+}
+
+// Returns the data pages in the usage map of table
+QVector<quint32> dataPages(MdbTableDef *table) {
+    MdbHandle *mdb = table->entry->mdb;
+    QVector<quint32> pages;
+    gint32 pg = 0;
+    forever {
+        const gint32 next = mdb_map_find_next(mdb, table->usage_map, table->map_sz, pg);
+        if (next <= pg)
+            break;
+        pg = next;
+        pages << quint32(pg);
+    }
+    return pages;
+}
+
+// Starts an empty data page of table in page
+void initDataPage(MdbTableDef *table, QByteArray &page) {
+    MdbHandle *mdb = table->entry->mdb;
+    page.fill('\0', mdb->fmt->pg_size);
+    unsigned char *pg = reinterpret_cast<unsigned char *>(page.data());
+    pg[0] = DataPageType;
+    pg[1] = 0x01;
+    mdb_put_int16(pg, 2, mdb->fmt->pg_size - mdb->fmt->row_count_offset - 2);
+    mdb_put_int32(pg, 4, table->entry->table_pg);
+}
+
+// Adds a packed row to a data page, rows are stored from the end of the page downwards.
+// Returns false if the page is full.
+bool addRow(MdbHandle *mdb, QByteArray &page, const QByteArray &row, int rowSize) {
+    const int rco = mdb->fmt->row_count_offset;
+    unsigned char *pg = reinterpret_cast<unsigned char *>(page.data());
+    const int rows = mdb_get_int16(pg, rco);
+    const int end = rows ? mdb_get_int16(pg, rco + 2 * rows) : page.size();
+    const int start = end - rowSize;
+    const int freeStart = rco + 2 + 2 * (rows + 1);
+    if (rows >= MaxRowsPerPage || start < freeStart)
+        return false;
+    memcpy(pg + start, row.constData(), rowSize);
+    mdb_put_int16(pg, rco + 2 + 2 * rows, start);
+    mdb_put_int16(pg, rco, rows + 1);
+    mdb_put_int16(pg, 2, start - freeStart);
+    return true;
+}
+
+bool writePage(QFile &out, int pageSize, quint32 pageNum, const QByteArray &page) {
+    return out.seek(qint64(pageNum) * pageSize) && out.write(page) == page.size();
+}
+
+// Replaces the usage map of the table by a type 1 map (a list of map pages) marking pages.
+// The map pages are appended at nextPage, the map row is rewritten in place.
+bool writeUsageMap(QFile &out, MdbHandle *mdb, qint64 mapOffset, int mapSize,
+                   const QVector<quint32> &pages, quint32 &nextPage) {
+    const int pageSize = mdb->fmt->pg_size;
+    const quint32 bitsPerPage = quint32(pageSize - 4) * 8;
+    quint32 lastPage = 0;
+    for (quint32 pg : pages)
+        lastPage = qMax(lastPage, pg);
+    const int mapPages = int(lastPage / bitsPerPage) + 1;
+    if (1 + 4 * mapPages > mapSize) {
+        qDebug() << "Usage map of" << mapSize << "bytes cannot hold" << mapPages << "map pages";
+        return false;
+    }
+
+    QVector<QByteArray> maps(mapPages);
+    for (quint32 pg : pages) {
+        QByteArray &map = maps[int(pg / bitsPerPage)];
+        if (map.isEmpty()) {
+            map.fill('\0', pageSize);
+            map[0] = char(UsageMapType);
+            map[1] = 0x01;
+        }
+        const quint32 bit = pg % bitsPerPage;
+        map[int(4 + bit / 8)] = char(map.at(int(4 + bit / 8)) | (1 << (bit % 8)));
+    }
+
+    QByteArray row(mapSize, '\0');
+    row[0] = 0x01;
+    for (int i = 0; i < mapPages; ++i) {
+        if (maps.at(i).isEmpty())
+            continue;
+        if (!writePage(out, pageSize, nextPage, maps.at(i)))
+            return false;
+        qToLittleEndian<quint32>(nextPage++, row.data() + 1 + 4 * i);
+    }
+    return out.seek(mapOffset) && out.write(row) == row.size();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("mdbfixturegen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Grows a copy of an Access database to a given number of rows "
+                                     "by cloning the rows of a template table.\n"
+                                     "New rows are written to new data pages appended to the file. "
+                                     "Indexes of the table are not updated, do not read the "
+                                     "generated table with MDBOPTS=use_index.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("template", "Template .mdb file");
+    parser.addPositionalArgument("output", "Generated .mdb file");
+    parser.addPositionalArgument("table", "Table to fill");
+    parser.addPositionalArgument("rows", "Target number of rows");
+    parser.process(a);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 4) {
+        parser.showHelp(1);
+    }
+    const QString templateFile = args.at(0);
+    const QString outputFile   = args.at(1);
+    const QString tableName    = args.at(2);
+    const qint64 targetRows    = args.at(3).toLongLong();
+
+    QFile::remove(outputFile);
+    if (!QFile::copy(templateFile, outputFile)) {
+        qDebug() << "Cannot copy" << templateFile << "to" << outputFile;
+        return 1;
+    }
+
+    MdbHandle *mdb = mdb_open(qPrintable(outputFile), MDB_NOFLAGS);
+    if (!mdb) {
+        qDebug() << "Error opening database" << outputFile;
+        return 2;
+    }
+
+    /* read the catalog */
+    if (!mdb_read_catalog(mdb, MDB_TABLE)) {
+        qDebug() << "File does not appear to be an Access database";
+        mdb_close(mdb);
+        return 3;
+    }
+
+    auto table = tableDef(mdb, tableName);
+    if (!table) {
+        mdb_close(mdb);
+        return 4;
+    }
+
+    const QList<SeedRow> seeds = seedRows(table);
+    if (seeds.isEmpty()) {
+        qDebug() << "Table" << tableName << "has no rows to clone";
+        mdb_free_tabledef(table);
+        mdb_close(mdb);
+        return 5;
+    }
+
+    // libmdb cannot allocate pages, the pages are written to the file directly
+    const int pageSize = mdb->fmt->pg_size;
+    const quint32 tablePage = table->entry->table_pg;
+    void *mapBuf = Q_NULLPTR;
+    int mapStart = 0;
+    size_t mapSize = 0;
+    mdb_read_pg(mdb, tablePage);
+    const int mapPgRow = mdb_get_int32(mdb->pg_buf, mdb->fmt->tab_usage_map_offset);
+    if (mdb_find_pg_row(mdb, mapPgRow, &mapBuf, &mapStart, &mapSize)) {
+        qDebug() << "Cannot find the usage map of" << tableName;
+        mdb_free_tabledef(table);
+        mdb_close(mdb);
+        return 6;
+    }
+    const qint64 mapOffset = qint64(mapPgRow >> 8) * pageSize + mapStart;
+
+    QFile out(outputFile);
+    if (!out.open(QIODevice::ReadWrite)) {
+        qDebug() << "Cannot write" << outputFile << out.errorString();
+        mdb_free_tabledef(table);
+        mdb_close(mdb);
+        return 6;
+    }
+    QVector<quint32> pages = dataPages(table);
+    quint32 nextPage = quint32(out.size() / pageSize);
+
+    QVector<MdbField> fields(table->num_cols);
+    QByteArray rowBuf(pageSize, '\0');
+    QByteArray page;
+    initDataPage(table, page);
+    bool ok = true;
+    qint64 rowNum = table->num_rows;
+    while (ok && rowNum < targetRows) {
+        SeedRow row = seeds.at(rowNum % seeds.size());
+        for (uint i = 0; i < table->num_cols && i < uint(row.values.size()); ++i) {
+            MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(table->columns, i));
+            if (!row.nulls.at(i))
+                varyValue(col, row.values[i], rowNum);
+            mdb_fill_temp_field(&fields[i], row.values[i].data(), row.values[i].size(),
+                                col->is_fixed, row.nulls.at(i), 0, col->col_num);
+        }
+        const int rowSize = mdb_pack_row(table, reinterpret_cast<unsigned char *>(rowBuf.data()),
+                                         table->num_cols, fields.data());
+        if (!addRow(mdb, page, rowBuf, rowSize)) {
+            ok = writePage(out, pageSize, nextPage, page);
+            pages << nextPage++;
+            initDataPage(table, page);
+            if (ok && !addRow(mdb, page, rowBuf, rowSize)) {
+                qDebug() << "Row" << rowNum << "does not fit into a page";
+                ok = false;
+            }
+        }
+        if (!ok)
+            break;
+        ++rowNum;
+        if (rowNum % 100000 == 0) {
+            qDebug() << rowNum << "rows";
+        }
+    }
+    if (ok && mdb_get_int16(page.data(), mdb->fmt->row_count_offset) > 0) {
+        ok = writePage(out, pageSize, nextPage, page);
+        pages << nextPage++;
+    }
+    ok = ok && writeUsageMap(out, mdb, mapOffset, int(mapSize), pages, nextPage);
+
+    // row count of the table definition
+    char count[4];
+    qToLittleEndian<qint32>(qint32(rowNum), count);
+    ok = ok && out.seek(qint64(tablePage) * pageSize + mdb->fmt->tab_num_rows_offset)
+            && out.write(count, sizeof(count)) == qint64(sizeof(count));
+    if (!ok)
+        qDebug() << "Cannot write" << outputFile << out.errorString();
+    out.close();
+
+    qDebug() << "Table" << tableName << "has" << rowNum << "rows";
+
+    mdb_free_tabledef(table);
+    mdb_close(mdb);
+
+    return ok && rowNum >= targetRows ? 0 : 7;
+}
@@ -0,0 +1,26 @@
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# to find file glib.h
+INCLUDEPATH += /usr/include/glib-2.0
+
+# to find file glibconfig.h
+INCLUDEPATH += /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+# the row offset flags are shared with the page decoder of the driver
+INCLUDEPATH += ../../mdbtools
+
+HEADERS += \
+    ../../mdbtools/qmdbtoolspagedecoder_p.h
+
+SOURCES += \
+        main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+unix:!macx: LIBS += -lmdb -lglib-2.0
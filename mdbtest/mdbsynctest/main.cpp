@@ -0,0 +1,358 @@
+#include <QtTest>
+#include <QtSql>
+
+#include <mdbtools.h>
+
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolstablescan_p.h"
+#include "qsql_mdbtools.h"
+
+// Incremental sync of QMdbToolsDriver::syncTable().
+//
+// Each test works on a copy of the fixture. The copy is synced, row slots of its data
+// pages are edited in place and the next sync must report exactly the edited rows.
+// The fixture is taken from QMDBTOOLS_TEST_DB (default Books_be.mdb of mdbdrivertest).
+
+// A live row slot of a data page, positions are offsets in the database file
+struct RowSlot
+{
+    quint32 page = 0;
+    int row = 0;
+    qint64 entryPos = 0;  ///< entry of the row offset table
+    qint64 start = 0;
+    int length = 0;
+};
+
+// The live rows of a table and the place of a value that is not part of the primary key
+struct TableLayout
+{
+    qint64 rowCount = 0;      ///< rows according to the table definition
+    QVector<RowSlot> rows;    ///< without rows pointing to an overflow row
+    int valueOffset = -1;     ///< offset in a row of a fixed column outside the primary key, -1 if none
+};
+
+static TableLayout readLayout(const QString &fileName, const QString &tableName)
+{
+    TableLayout res;
+    MdbHandle *mdb = mdb_open(qPrintable(fileName), MDB_NOFLAGS);
+    if (!mdb)
+        return res;
+    MdbTableDef *table = Q_NULLPTR;
+    if (mdb_read_catalog(mdb, MDB_TABLE))
+        table = mdb_read_table_by_name(mdb, const_cast<char *>(qUtf8Printable(tableName)), MDB_TABLE);
+    if (!table) {
+        mdb_close(mdb);
+        return res;
+    }
+    mdb_read_columns(table);
+    mdb_read_indices(table);
+    res.rowCount = table->num_rows;
+
+    QSet<int> keyCols;
+    for (uint i = 0; i < table->num_idxs; i++) {
+        MdbIndex *idx = static_cast<MdbIndex *>(g_ptr_array_index(table->indices, i));
+        if (idx->index_type != 1)
+            continue;
+        for (int k = 0; k < idx->num_keys; ++k)
+            keyCols << idx->key_col_num[k] - 1;
+        break;
+    }
+    // fixed values follow the column count, booleans are kept in the null mask
+    for (uint i = 0; i < table->num_cols; i++) {
+        MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(table->columns, i));
+        if (col->is_fixed && col->col_type != MDB_BOOL && col->col_size > 0 && !keyCols.contains(int(i))) {
+            res.valueOffset = (IS_JET3(mdb) ? 1 : 2) + col->fixed_offset;
+            break;
+        }
+    }
+
+    const int rco      = mdb->fmt->row_count_offset;
+    const int pageSize = mdb->fmt->pg_size;
+    QMdbToolsPageWalk walk(table);
+    while (walk.nextDataPage()) {
+        const qint64 pagePos = qint64(walk.page()) * pageSize;
+        const int rows = mdb_get_int16(mdb->pg_buf, rco);
+        int nextStart = pageSize;
+        for (int r = 0; r < rows; ++r) {
+            const int entry = mdb_get_int16(mdb->pg_buf, rco + 2 + r * 2);
+            const int start = QMdbToolsPageDecoder::rowStart(entry);
+            const int end   = nextStart;
+            nextStart = start;
+            if (QMdbToolsPageDecoder::isDeletedRow(entry) || (entry & QMdbToolsPageDecoder::RowLookup))
+                continue;
+            if (start >= end || end > pageSize)
+                continue;
+            RowSlot slot;
+            slot.page = walk.page();
+            slot.row = r;
+            slot.entryPos = pagePos + rco + 2 + r * 2;
+            slot.start = pagePos + start;
+            slot.length = end - start;
+            res.rows << slot;
+        }
+    }
+    mdb_free_tabledef(table);
+    mdb_close(mdb);
+    return res;
+}
+
+static QByteArray readBytes(const QString &fileName, qint64 pos, int size)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(pos))
+        return QByteArray();
+    return file.read(size);
+}
+
+// Writes bytes at pos and moves the modification time forward, so the sync does not
+// take the file for unchanged
+static bool writeBytes(const QString &fileName, qint64 pos, const QByteArray &bytes)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(pos) || file.write(bytes) != bytes.size())
+        return false;
+    const QDateTime modified = file.fileTime(QFileDevice::FileModificationTime);
+    return file.setFileTime(modified.addSecs(2), QFileDevice::FileModificationTime);
+}
+
+static bool setDeleted(const QString &fileName, const RowSlot &slot, bool deleted)
+{
+    QByteArray entry = readBytes(fileName, slot.entryPos, 2);
+    if (entry.size() != 2)
+        return false;
+    quint16 value = qFromLittleEndian<quint16>(entry.constData());
+    if (deleted)
+        value |= QMdbToolsPageDecoder::RowDeleted;
+    else
+        value &= ~quint16(QMdbToolsPageDecoder::RowDeleted);
+    qToLittleEndian(value, entry.data());
+    return writeBytes(fileName, slot.entryPos, entry);
+}
+
+class MdbSyncTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void firstSync();
+    void removedRow();
+    void insertedRow();
+    void changedRow();
+    void movedRow();
+    void sharedStateFile();
+    void invalidStateFile();
+    void nullChangeList();
+
+private:
+    bool sync(const QString &table, QVector<QMdbToolsRowChange> *changes, QString *error = Q_NULLPTR);
+
+    QString m_dbName;
+    QString m_table;        ///< table with the most rows
+    QString m_otherTable;   ///< any other table
+    QTemporaryDir m_dir;
+    QString m_copy;         ///< copy of the fixture for the running test
+    QString m_stateFile;
+    TableLayout m_layout;
+};
+
+void MdbSyncTest::initTestCase()
+{
+    m_dbName = qEnvironmentVariable("QMDBTOOLS_TEST_DB", QFINDTESTDATA("../mdbdrivertest/Books_be.mdb"));
+    if (!QFile::exists(m_dbName))
+        QSKIP(qPrintable(QString("Fixture %1 not found").arg(m_dbName)));
+    QVERIFY(m_dir.isValid());
+
+    QMdbToolsDriver driver;
+    QVERIFY2(driver.open(m_dbName, QString(), QString(), QString(), 0, QString()),
+             qPrintable(driver.lastError().text()));
+    const QStringList tables = driver.tables(QSql::Tables);
+    driver.close();
+    for (const auto &table : tables) {
+        const TableLayout layout = readLayout(m_dbName, table);
+        if (m_table.isEmpty() || layout.rows.size() > m_layout.rows.size()) {
+            if (!m_table.isEmpty())
+                m_otherTable = m_table;
+            m_table = table;
+            m_layout = layout;
+        } else if (m_otherTable.isEmpty()) {
+            m_otherTable = table;
+        }
+    }
+    if (m_layout.rows.isEmpty())
+        QSKIP("Fixture has no table with rows");
+}
+
+void MdbSyncTest::init()
+{
+    static int count = 0;
+    m_copy = m_dir.filePath(QString("sync%1.mdb").arg(++count));
+    m_stateFile = m_copy + ".sync";
+    QVERIFY(QFile::copy(m_dbName, m_copy));
+    QVERIFY(QFile::setPermissions(m_copy, QFile::ReadOwner | QFile::WriteOwner));
+}
+
+bool MdbSyncTest::sync(const QString &table, QVector<QMdbToolsRowChange> *changes, QString *error)
+{
+    QMdbToolsDriver driver;
+    bool ok = driver.open(m_copy, QString(), QString(), QString(), 0, QString());
+    if (ok)
+        ok = driver.syncTable(table, m_stateFile, changes);
+    if (error)
+        *error = driver.lastError().nativeErrorCode();
+    if (!ok)
+        qWarning() << driver.lastError().text();
+    driver.close();
+    return ok;
+}
+
+void MdbSyncTest::firstSync()
+{
+    QVector<QMdbToolsRowChange> changes;
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(qint64(changes.size()), m_layout.rowCount);
+    for (const auto &change : qAsConst(changes)) {
+        QCOMPARE(change.type, QMdbToolsRowChange::Inserted);
+        QVERIFY(!change.values.isEmpty());
+    }
+
+    // the file did not change
+    QVERIFY(sync(m_table, &changes));
+    QVERIFY(changes.isEmpty());
+}
+
+void MdbSyncTest::removedRow()
+{
+    const RowSlot slot = m_layout.rows.last();
+    QVector<QMdbToolsRowChange> changes;
+    QVERIFY(sync(m_table, &changes));
+
+    QVERIFY(setDeleted(m_copy, slot, true));
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().type, QMdbToolsRowChange::Removed);
+    QCOMPARE(changes.first().page, slot.page);
+    QCOMPARE(changes.first().row, slot.row);
+    QVERIFY(changes.first().values.isEmpty());
+}
+
+void MdbSyncTest::insertedRow()
+{
+    const RowSlot slot = m_layout.rows.last();
+    QVERIFY(setDeleted(m_copy, slot, true));
+    QVector<QMdbToolsRowChange> changes;
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(qint64(changes.size()), m_layout.rowCount - 1);
+
+    QVERIFY(setDeleted(m_copy, slot, false));
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().type, QMdbToolsRowChange::Inserted);
+    QCOMPARE(changes.first().page, slot.page);
+    QCOMPARE(changes.first().row, slot.row);
+    QVERIFY(!changes.first().values.isEmpty());
+}
+
+void MdbSyncTest::changedRow()
+{
+    if (m_layout.valueOffset < 0)
+        QSKIP("Table has no fixed column outside the primary key");
+    const RowSlot slot = m_layout.rows.last();
+    if (m_layout.valueOffset >= slot.length)
+        QSKIP("Row is shorter than the fixed columns");
+    QVector<QMdbToolsRowChange> changes;
+    QVERIFY(sync(m_table, &changes));
+
+    const qint64 pos = slot.start + m_layout.valueOffset;
+    QByteArray value = readBytes(m_copy, pos, 1);
+    QCOMPARE(value.size(), 1);
+    value[0] = char(value.at(0) ^ 0x01);
+    QVERIFY(writeBytes(m_copy, pos, value));
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().type, QMdbToolsRowChange::Changed);
+    QCOMPARE(changes.first().page, slot.page);
+    QCOMPARE(changes.first().row, slot.row);
+    QVERIFY(!changes.first().values.isEmpty());
+}
+
+void MdbSyncTest::movedRow()
+{
+    // two rows of a page with the same length and different content
+    RowSlot from, to;
+    bool found = false;
+    for (int i = 0; i < m_layout.rows.size() && !found; ++i) {
+        for (int j = i + 1; j < m_layout.rows.size() && !found; ++j) {
+            const RowSlot &a = m_layout.rows.at(i);
+            const RowSlot &b = m_layout.rows.at(j);
+            if (a.page != b.page || a.length != b.length)
+                continue;
+            if (readBytes(m_copy, a.start, a.length) == readBytes(m_copy, b.start, b.length))
+                continue;
+            from = a;
+            to = b;
+            found = true;
+        }
+    }
+    if (!found)
+        QSKIP("Table has no two rows of the same length on one page");
+
+    // the slot the row moves to is free at the first sync
+    QVERIFY(setDeleted(m_copy, to, true));
+    QVector<QMdbToolsRowChange> changes;
+    QVERIFY(sync(m_table, &changes));
+
+    QVERIFY(writeBytes(m_copy, to.start, readBytes(m_copy, from.start, from.length)));
+    QVERIFY(setDeleted(m_copy, to, false));
+    QVERIFY(setDeleted(m_copy, from, true));
+    QVERIFY(sync(m_table, &changes));
+    QVERIFY2(changes.isEmpty(), qPrintable(QString("%1 changes").arg(changes.size())));
+}
+
+void MdbSyncTest::sharedStateFile()
+{
+    if (m_otherTable.isEmpty())
+        QSKIP("Fixture has a single table");
+    QVector<QMdbToolsRowChange> changes;
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(qint64(changes.size()), m_layout.rowCount);
+    QVERIFY(sync(m_otherTable, &changes));
+    QCOMPARE(qint64(changes.size()), readLayout(m_copy, m_otherTable).rowCount);
+
+    // the sync of the other table kept the fingerprints of the first one
+    QVERIFY(sync(m_table, &changes));
+    QVERIFY(changes.isEmpty());
+
+    // pages are compared once the file changed
+    const RowSlot slot = m_layout.rows.last();
+    QVERIFY(setDeleted(m_copy, slot, true));
+    QVERIFY(sync(m_table, &changes));
+    QCOMPARE(changes.size(), 1);
+    QCOMPARE(changes.first().type, QMdbToolsRowChange::Removed);
+}
+
+void MdbSyncTest::invalidStateFile()
+{
+    QFile state(m_stateFile);
+    QVERIFY(state.open(QIODevice::WriteOnly));
+    QVERIFY(state.write("no fingerprints") > 0);
+    state.close();
+
+    QVector<QMdbToolsRowChange> changes;
+    QString error;
+    QVERIFY(!sync(m_table, &changes, &error));
+    QCOMPARE(error, QString("-17"));
+}
+
+void MdbSyncTest::nullChangeList()
+{
+    QString error;
+    QVERIFY(!sync(m_table, Q_NULLPTR, &error));
+    QCOMPARE(error, QString("-17"));
+}
+
+QTEST_GUILESS_MAIN(MdbSyncTest)
+
+#include "main.moc"
@@ -0,0 +1,51 @@
+QT -= gui
+QT += core-private sql-private testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = mdbsynctest
+
+# to find file glib.h
+INCLUDEPATH += /usr/include/glib-2.0
+
+# to find file glibconfig.h
+INCLUDEPATH += /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+# the driver is built into the test, syncTable() is not reachable through the plugin
+INCLUDEPATH += ../../mdbtools
+DEFINES += QT_PLUGIN
+
+HEADERS += \
+    ../../mdbtools/qmdbtoolsexport_p.h \
+    ../../mdbtools/qmdbtoolsfingerprint_p.h \
+    ../../mdbtools/qmdbtoolspagedecoder_p.h \
+    ../../mdbtools/qmdbtoolsresultcache_p.h \
+    ../../mdbtools/qmdbtoolsrowstore_p.h \
+    ../../mdbtools/qmdbtoolssnapshot_p.h \
+    ../../mdbtools/qmdbtoolstablescan_p.h \
+    ../../mdbtools/qmdbtoolstablestats_p.h \
+    ../../mdbtools/qmdbtoolszonemap_p.h \
+    ../../mdbtools/qsql_mdbtools.h
+
+SOURCES += \
+        main.cpp \
+        ../../mdbtools/qmdbtoolsexport.cpp \
+        ../../mdbtools/qmdbtoolsfingerprint.cpp \
+        ../../mdbtools/qmdbtoolspagedecoder.cpp \
+        ../../mdbtools/qmdbtoolsresultcache.cpp \
+        ../../mdbtools/qmdbtoolsrowstore.cpp \
+        ../../mdbtools/qmdbtoolssnapshot.cpp \
+        ../../mdbtools/qmdbtoolstablescan.cpp \
+        ../../mdbtools/qmdbtoolstablestats.cpp \
+        ../../mdbtools/qmdbtoolszonemap.cpp \
+        ../../mdbtools/qsql_mdbtools.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+DISTFILES += ../mdbdrivertest/Books_be.mdb
+
+unix:!macx: LIBS += -lmdbsql -lmdb -lglib-2.0
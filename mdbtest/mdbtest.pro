@@ -1,5 +1,9 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
+    mdbbenchtest \
     mdbdrivertest \
-    mdblibtest
+    mdbexporttest \
+    mdbfixturegen \
+    mdblibtest \
+    mdbsynctest
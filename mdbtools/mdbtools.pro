@@ -21,10 +21,28 @@ INCLUDEPATH += /usr/include/glib-2.0
 INCLUDEPATH += /usr/lib/x86_64-linux-gnu/glib-2.0/include
 
 HEADERS += \
+    qmdbtoolsexport_p.h \
+    qmdbtoolsfingerprint_p.h \
+    qmdbtoolspagedecoder_p.h \
+    qmdbtoolsresultcache_p.h \
+    qmdbtoolsrowstore_p.h \
+    qmdbtoolssnapshot_p.h \
+    qmdbtoolstablescan_p.h \
+    qmdbtoolstablestats_p.h \
+    qmdbtoolszonemap_p.h \
     qsql_mdbtools.h
 
 SOURCES += \
         main.cpp \
+        qmdbtoolsexport.cpp \
+        qmdbtoolsfingerprint.cpp \
+        qmdbtoolspagedecoder.cpp \
+        qmdbtoolsresultcache.cpp \
+        qmdbtoolsrowstore.cpp \
+        qmdbtoolssnapshot.cpp \
+        qmdbtoolstablescan.cpp \
+        qmdbtoolstablestats.cpp \
+        qmdbtoolszonemap.cpp \
         qsql_mdbtools.cpp
 
 OTHER_FILES += mdbtools.json
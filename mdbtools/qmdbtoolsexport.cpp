@@ -0,0 +1,755 @@
+#include "qmdbtoolsexport_p.h"
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolstablescan_p.h"
+
+#include <QDir>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+static const int BatchRows = 65536;                       ///< max rows of an Arrow record batch
+static const qint64 MaxBatchBytes = 64 * 1024 * 1024;     ///< max variable-width data of a record batch
+static const int BlockSize = 4 * 1024 * 1024;             ///< output is written in blocks of this size
+
+enum ArrowKind { BoolKind, UInt8Kind, Int16Kind, Int32Kind, FloatKind, DoubleKind,
+                 TimestampKind, Utf8Kind, BinaryKind };
+
+// Arrow IPC constants, see Schema.fbs and Message.fbs of the Arrow format
+enum ArrowType { ArrowInt = 2, ArrowFloatingPoint = 3, ArrowBinary = 4, ArrowUtf8 = 5,
+                 ArrowBool = 6, ArrowTimestamp = 10 };
+static const int ArrowMetadataV5 = 4;
+static const int ArrowSchemaHeader = 1;
+static const int ArrowRecordBatchHeader = 3;
+static const quint32 ArrowContinuation = 0xffffffff;
+
+/************************************************************/
+
+static int qArrowKind(int colType)
+{
+    switch (colType) {
+    case MDB_BOOL:
+        return BoolKind;
+    case MDB_BYTE:
+        return UInt8Kind;
+    case MDB_INT:
+        return Int16Kind;
+    case MDB_LONGINT:
+        return Int32Kind;
+    case MDB_FLOAT:
+        return FloatKind;
+    case MDB_DOUBLE:
+        return DoubleKind;
+    case MDB_DATETIME:
+        return TimestampKind;
+    case MDB_OLE:
+        return BinaryKind;
+    }
+    return Utf8Kind;
+}
+
+/************************************************************/
+/// Converts an Access date (days since 1899-12-30, the fraction is the time of day
+/// also for negative values) into msecs since the Unix epoch
+static qint64 qMsecsSinceEpoch(double value)
+{
+    const double days = std::trunc(value);
+    const double time = std::fabs(value - days);
+    return (qint64(days) - 25569) * 86400000 + qRound64(time * 86400000.0);
+}
+
+/************************************************************/
+
+template <typename T>
+static void qAppendLittleEndian(QByteArray &buf, T value)
+{
+    char tmp[sizeof(T)];
+    qToLittleEndian<T>(value, tmp);
+    buf.append(tmp, int(sizeof(T)));
+}
+
+/************************************************************/
+
+static void qAlignBuffer(QByteArray &buf, int align)
+{
+    const int pad = (align - buf.size() % align) % align;
+    if (pad)
+        buf.append(pad, '\0');
+}
+
+/************************************************************/
+/// Object of the FlatBuffers encoded Arrow metadata: a table, a string,
+/// a vector of tables or a vector of structs
+struct QMdbToolsFlatNode
+{
+    enum Kind { Table, String, TableVector, StructVector };
+    struct Slot {
+        int id;
+        int size;                                 ///< size of a scalar, 4 for an offset
+        quint64 bits;
+        QSharedPointer<QMdbToolsFlatNode> child;
+    };
+
+    Kind kind = Table;
+    QVector<Slot> slots;
+    QByteArray bytes;
+    int count = 0;
+    QVector<QSharedPointer<QMdbToolsFlatNode>> items;
+
+    QMdbToolsFlatNode &add(int id, int size, quint64 bits) {
+        slots.append({ id, size, bits, QSharedPointer<QMdbToolsFlatNode>() });
+        return *this;
+    }
+    QMdbToolsFlatNode &add(int id, const QSharedPointer<QMdbToolsFlatNode> &child) {
+        slots.append({ id, 4, 0, child });
+        return *this;
+    }
+};
+
+typedef QSharedPointer<QMdbToolsFlatNode> QMdbToolsFlatRef;
+
+static QMdbToolsFlatRef qFlatTable()
+{
+    return QMdbToolsFlatRef(new QMdbToolsFlatNode);
+}
+
+static QMdbToolsFlatRef qFlatString(const QByteArray &str)
+{
+    QMdbToolsFlatRef node(new QMdbToolsFlatNode);
+    node->kind = QMdbToolsFlatNode::String;
+    node->bytes = str;
+    return node;
+}
+
+static QMdbToolsFlatRef qFlatTables(const QVector<QMdbToolsFlatRef> &items)
+{
+    QMdbToolsFlatRef node(new QMdbToolsFlatNode);
+    node->kind = QMdbToolsFlatNode::TableVector;
+    node->items = items;
+    return node;
+}
+
+static QMdbToolsFlatRef qFlatStructs(const QByteArray &data, int count)
+{
+    QMdbToolsFlatRef node(new QMdbToolsFlatNode);
+    node->kind = QMdbToolsFlatNode::StructVector;
+    node->bytes = data;
+    node->count = count;
+    return node;
+}
+
+/************************************************************/
+/// Minimal FlatBuffers encoder. Objects are written front to back,
+/// every object is followed by the objects it refers to, so all offsets point forward.
+class QMdbToolsFlatWriter
+{
+public:
+    QByteArray finish(const QMdbToolsFlatRef &root) {
+        m_buf.clear();
+        m_buf.append(4, '\0');
+        const int pos = write(root);
+        patch(0, pos);
+        qAlignBuffer(m_buf, 8);
+        return m_buf;
+    }
+
+private:
+    void patch(int at, int target) {
+        qToLittleEndian<quint32>(quint32(target - at), m_buf.data() + at);
+    }
+
+    int write(const QMdbToolsFlatRef &node);
+
+    QByteArray m_buf;
+};
+
+/************************************************************/
+
+int QMdbToolsFlatWriter::write(const QMdbToolsFlatRef &node)
+{
+    switch (node->kind) {
+    case QMdbToolsFlatNode::String: {
+        qAlignBuffer(m_buf, 4);
+        const int pos = m_buf.size();
+        qAppendLittleEndian<quint32>(m_buf, quint32(node->bytes.size()));
+        m_buf.append(node->bytes);
+        m_buf.append('\0');
+        return pos;
+    }
+    case QMdbToolsFlatNode::StructVector: {
+        // Arrow structs hold 64 bit fields, the elements start 8 byte aligned
+        qAlignBuffer(m_buf, 4);
+        if ((m_buf.size() + 4) % 8)
+            m_buf.append(4, '\0');
+        const int pos = m_buf.size();
+        qAppendLittleEndian<quint32>(m_buf, quint32(node->count));
+        m_buf.append(node->bytes);
+        return pos;
+    }
+    case QMdbToolsFlatNode::TableVector: {
+        qAlignBuffer(m_buf, 4);
+        const int pos = m_buf.size();
+        qAppendLittleEndian<quint32>(m_buf, quint32(node->items.size()));
+        m_buf.append(node->items.size() * 4, '\0');
+        for (int i = 0; i < node->items.size(); ++i) {
+            const int at = pos + 4 + i * 4;
+            patch(at, write(node->items.at(i)));
+        }
+        return pos;
+    }
+    case QMdbToolsFlatNode::Table:
+        break;
+    }
+
+    // inline layout: soffset to the vtable, then the fields by decreasing size
+    const QVector<QMdbToolsFlatNode::Slot> &slots = node->slots;
+    int fieldCount = 0;
+    for (const auto &slot : slots)
+        fieldCount = qMax(fieldCount, slot.id + 1);
+    QVector<int> offsets(slots.size());
+    int size = 4;
+    for (int s = 8; s > 0; s /= 2) {
+        for (int i = 0; i < slots.size(); ++i) {
+            if (slots.at(i).size != s)
+                continue;
+            size = (size + s - 1) / s * s;
+            offsets[i] = size;
+            size += s;
+        }
+    }
+
+    qAlignBuffer(m_buf, 2);
+    const int vtable = m_buf.size();
+    QVector<quint16> entries(fieldCount, 0);
+    for (int i = 0; i < slots.size(); ++i)
+        entries[slots.at(i).id] = quint16(offsets.at(i));
+    qAppendLittleEndian<quint16>(m_buf, quint16(4 + 2 * fieldCount));
+    qAppendLittleEndian<quint16>(m_buf, quint16(size));
+    for (quint16 entry : entries)
+        qAppendLittleEndian<quint16>(m_buf, entry);
+
+    qAlignBuffer(m_buf, 8);
+    const int pos = m_buf.size();
+    m_buf.append(size, '\0');
+    qToLittleEndian<qint32>(pos - vtable, m_buf.data() + pos);
+    for (int i = 0; i < slots.size(); ++i) {
+        const auto &slot = slots.at(i);
+        char *dst = m_buf.data() + pos + offsets.at(i);
+        switch (slot.child ? 0 : slot.size) {
+        case 1:
+            *dst = char(slot.bits);
+            break;
+        case 2:
+            qToLittleEndian<quint16>(quint16(slot.bits), dst);
+            break;
+        case 4:
+            qToLittleEndian<quint32>(quint32(slot.bits), dst);
+            break;
+        case 8:
+            qToLittleEndian<quint64>(slot.bits, dst);
+            break;
+        }
+    }
+    for (int i = 0; i < slots.size(); ++i) {
+        if (slots.at(i).child)
+            patch(pos + offsets.at(i), write(slots.at(i).child));
+    }
+    return pos;
+}
+
+/************************************************************/
+/// Appends an encapsulated Arrow IPC message (without body) to buf
+static void qAppendArrowMessage(QByteArray &buf, int headerType, const QMdbToolsFlatRef &header, qint64 bodyLength)
+{
+    QMdbToolsFlatRef message = qFlatTable();
+    message->add(0, 2, ArrowMetadataV5)
+            .add(1, 1, quint64(headerType))
+            .add(2, header)
+            .add(3, 8, quint64(bodyLength));
+    const QByteArray metadata = QMdbToolsFlatWriter().finish(message);
+    qAppendLittleEndian<quint32>(buf, ArrowContinuation);
+    qAppendLittleEndian<qint32>(buf, metadata.size());
+    buf.append(metadata);
+}
+
+/************************************************************/
+
+QMdbToolsExporter::QMdbToolsExporter(MdbHandle *mdb, MdbTableDef *table, const QList<MdbColumn*> &cols,
+                                     Format format)
+    : m_mdb(mdb)
+    , m_table(table)
+    , m_format(format)
+{
+    m_columns.resize(cols.size());
+    for (int i = 0; i < cols.size(); ++i) {
+        Column &c = m_columns[i];
+        c.col = cols.at(i);
+        c.kind = qArrowKind(c.col->col_type);
+        c.shortDate = c.kind == TimestampKind && QMdbToolsPageDecoder::isShortDate(c.col);
+    }
+}
+
+/************************************************************/
+
+QString QMdbToolsExporter::fileSuffix(Format format)
+{
+    return QLatin1String(format == ArrowFormat ? "arrows" : "csv");
+}
+
+/************************************************************/
+/// Writes all rows of the scan to fileName.
+/// \return true on success, otherwise false and error is set
+bool QMdbToolsExporter::run(const QString &fileName, const QAtomicInt *stop, QString *error)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    m_file = &file;
+    m_buf.reserve(BlockSize + BlockSize / 4);
+    m_rows = 0;
+
+    if (m_format == ArrowFormat) {
+        writeArrowSchema();
+        resetBatch();
+    } else {
+        writeCsvHeader();
+    }
+
+    bool ok = true;
+    QMdbToolsTableScan scan(m_table, stop);
+    while (ok && scan.fetchRow()) {
+        if (m_format == ArrowFormat) {
+            appendArrowRow();
+            if (m_batchRows == BatchRows || m_batchBytes >= MaxBatchBytes)
+                writeArrowBatch();
+        } else {
+            appendCsvRow();
+        }
+        ++m_rows;
+        if (m_buf.size() >= BlockSize)
+            ok = flush();
+    }
+    if (scan.status() == QMdbToolsTableScan::Stopped) {
+        *error = QString::fromUtf8("Export cancelled");
+        ok = false;
+    }
+
+    if (ok && m_format == ArrowFormat) {
+        if (m_batchRows > 0)
+            writeArrowBatch();
+        // end of stream
+        qAppendLittleEndian<quint32>(m_buf, ArrowContinuation);
+        qAppendLittleEndian<quint32>(m_buf, 0);
+    }
+    ok = ok && flush();
+    m_file = Q_NULLPTR;
+
+    if (!ok || !file.commit()) {
+        if (error->isEmpty())
+            *error = file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+
+bool QMdbToolsExporter::flush()
+{
+    if (m_file->write(m_buf) != m_buf.size())
+        return false;
+    m_buf.resize(0);
+    return true;
+}
+
+/************************************************************/
+/// Appends the value of a variable-width column of the current row as UTF-8,
+/// OLE values as raw bytes
+void QMdbToolsExporter::appendVariable(const Column &c, QByteArray &out) const
+{
+    MdbColumn *col = c.col;
+    if (col->col_type != MDB_OLE) {
+        out += QMdbToolsPageDecoder::columnText(m_mdb, col).toUtf8();
+        return;
+    }
+    if (col->bind_ptr && mdb_get_int32(col->bind_ptr, 0)) {
+        size_t size = 0;
+        void *data = mdb_ole_read_full(m_mdb, col, &size);
+        out.append(static_cast<const char *>(data), int(size));
+        g_free(data);
+    }
+}
+
+/************************************************************/
+
+void QMdbToolsExporter::appendInt(int value)
+{
+    char tmp[16];
+    const int n = qsnprintf(tmp, sizeof(tmp), "%d", value);
+    m_buf.append(tmp, n);
+}
+
+/************************************************************/
+
+void QMdbToolsExporter::appendDate(double value, bool shortDate)
+{
+    struct tm t = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    mdb_date_to_tm(value, &t);
+    char tmp[32];
+    const int n = shortDate
+            ? qsnprintf(tmp, sizeof(tmp), "%04d-%02d-%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday)
+            : qsnprintf(tmp, sizeof(tmp), "%04d-%02d-%02d %02d:%02d:%02d", t.tm_year + 1900, t.tm_mon + 1,
+                        t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    m_buf.append(tmp, n);
+}
+
+/************************************************************/
+
+void QMdbToolsExporter::writeCsvHeader()
+{
+    for (int i = 0; i < m_columns.size(); ++i) {
+        if (i)
+            m_buf += ',';
+        m_buf += '"';
+        m_buf += QByteArray(m_columns.at(i).col->name).replace('"', "\"\"");
+        m_buf += '"';
+    }
+    m_buf += '\n';
+}
+
+/************************************************************/
+/// Formats the current row as a CSV line: text is quoted, nulls are empty,
+/// dates are ISO 8601, OLE values are hex encoded
+void QMdbToolsExporter::appendCsvRow()
+{
+    const unsigned char *page = m_mdb->pg_buf;
+    for (int i = 0; i < m_columns.size(); ++i) {
+        const Column &c = m_columns.at(i);
+        MdbColumn *col = c.col;
+        if (i)
+            m_buf += ',';
+        if (c.kind == BoolKind) {
+            m_buf += QMdbToolsPageDecoder::boolValue(col) ? '1' : '0';
+            continue;
+        }
+        if (col->cur_value_len == 0)
+            continue;
+        const unsigned char *value = page + col->cur_value_start;
+        switch (c.kind) {
+        case UInt8Kind:
+            appendInt(value[0]);
+            break;
+        case Int16Kind:
+            appendInt(qFromLittleEndian<qint16>(value));
+            break;
+        case Int32Kind:
+            appendInt(qFromLittleEndian<qint32>(value));
+            break;
+        case FloatKind:
+            m_buf += QByteArray::number(qFromLittleEndian<float>(value), 'g', 9);
+            break;
+        case DoubleKind:
+            m_buf += QByteArray::number(qFromLittleEndian<double>(value), 'g', 17);
+            break;
+        case TimestampKind:
+            appendDate(qFromLittleEndian<double>(value), c.shortDate);
+            break;
+        case BinaryKind:
+            m_cell.resize(0);
+            appendVariable(c, m_cell);
+            m_buf += m_cell.toHex();
+            break;
+        default:
+            m_cell.resize(0);
+            appendVariable(c, m_cell);
+            m_buf += '"';
+            if (m_cell.contains('"'))
+                m_cell.replace('"', "\"\"");
+            m_buf += m_cell;
+            m_buf += '"';
+            break;
+        }
+    }
+    m_buf += '\n';
+}
+
+/************************************************************/
+
+void QMdbToolsExporter::writeArrowSchema()
+{
+    QVector<QMdbToolsFlatRef> fields;
+    for (const auto &c : m_columns) {
+        QMdbToolsFlatRef type = qFlatTable();
+        int typeId = ArrowUtf8;
+        switch (c.kind) {
+        case BoolKind:
+            typeId = ArrowBool;
+            break;
+        case UInt8Kind:
+            typeId = ArrowInt;
+            type->add(0, 4, 8).add(1, 1, 0);
+            break;
+        case Int16Kind:
+            typeId = ArrowInt;
+            type->add(0, 4, 16).add(1, 1, 1);
+            break;
+        case Int32Kind:
+            typeId = ArrowInt;
+            type->add(0, 4, 32).add(1, 1, 1);
+            break;
+        case FloatKind:
+            typeId = ArrowFloatingPoint;
+            type->add(0, 2, 1); // SINGLE
+            break;
+        case DoubleKind:
+            typeId = ArrowFloatingPoint;
+            type->add(0, 2, 2); // DOUBLE
+            break;
+        case TimestampKind:
+            typeId = ArrowTimestamp;
+            type->add(0, 2, 1); // MILLISECOND, no time zone
+            break;
+        case BinaryKind:
+            typeId = ArrowBinary;
+            break;
+        }
+        QMdbToolsFlatRef field = qFlatTable();
+        field->add(0, qFlatString(QByteArray(c.col->name)))
+                .add(1, 1, c.kind != BoolKind)
+                .add(2, 1, quint64(typeId))
+                .add(3, type)
+                .add(5, qFlatTables(QVector<QMdbToolsFlatRef>()));
+        fields << field;
+    }
+    QMdbToolsFlatRef schema = qFlatTable();
+    schema->add(1, qFlatTables(fields));
+    qAppendArrowMessage(m_buf, ArrowSchemaHeader, schema, 0);
+}
+
+/************************************************************/
+
+void QMdbToolsExporter::resetBatch()
+{
+    for (auto &c : m_columns) {
+        c.validity.resize(0);
+        c.values.resize(0);
+        c.offsets.resize(0);
+        if (c.kind == Utf8Kind || c.kind == BinaryKind)
+            c.offsets.append(0);
+        c.nullCount = 0;
+    }
+    m_batchRows = 0;
+    m_batchBytes = 0;
+}
+
+/************************************************************/
+/// Appends the current row to the column builders of the record batch.
+/// Fixed-width values are little endian on the page as in Arrow and are copied as is.
+void QMdbToolsExporter::appendArrowRow()
+{
+    const unsigned char *page = m_mdb->pg_buf;
+    const int row = m_batchRows;
+    const char bit = char(1 << (row & 7));
+    for (auto &c : m_columns) {
+        MdbColumn *col = c.col;
+        if ((row & 7) == 0) {
+            c.validity.append('\0');
+            if (c.kind == BoolKind)
+                c.values.append('\0');
+        }
+        if (c.kind == BoolKind) {
+            if (QMdbToolsPageDecoder::boolValue(col))
+                c.values.data()[row >> 3] |= bit;
+            continue;
+        }
+        const bool isNull = QMdbToolsPageDecoder::isNullValue(col);
+        if (isNull)
+            c.nullCount++;
+        else
+            c.validity.data()[row >> 3] |= bit;
+        const char *value = reinterpret_cast<const char *>(page + col->cur_value_start);
+        switch (c.kind) {
+        case UInt8Kind:
+            c.values.append(isNull ? '\0' : value[0]);
+            break;
+        case Int16Kind:
+            if (isNull)
+                c.values.append(2, '\0');
+            else
+                c.values.append(value, 2);
+            break;
+        case Int32Kind:
+        case FloatKind:
+            if (isNull)
+                c.values.append(4, '\0');
+            else
+                c.values.append(value, 4);
+            break;
+        case DoubleKind:
+            if (isNull)
+                c.values.append(8, '\0');
+            else
+                c.values.append(value, 8);
+            break;
+        case TimestampKind:
+            qAppendLittleEndian<qint64>(c.values,
+                                        isNull ? 0 : qMsecsSinceEpoch(qFromLittleEndian<double>(value)));
+            break;
+        default: {
+            const int before = c.values.size();
+            if (!isNull)
+                appendVariable(c, c.values);
+            c.offsets.append(qToLittleEndian<qint32>(c.values.size()));
+            m_batchBytes += c.values.size() - before;
+            break;
+        }
+        }
+    }
+    m_batchRows++;
+}
+
+/************************************************************/
+/// Writes the collected rows as a record batch message and its body
+void QMdbToolsExporter::writeArrowBatch()
+{
+    struct Buffer {
+        const char *data;
+        qint64 size;
+    };
+    QVector<Buffer> buffers;
+    QByteArray nodes;
+    for (const auto &c : m_columns) {
+        qAppendLittleEndian<qint64>(nodes, m_batchRows);
+        qAppendLittleEndian<qint64>(nodes, c.nullCount);
+        // the validity bitmap may be left out when there are no nulls
+        buffers.append({ c.validity.constData(), c.nullCount ? c.validity.size() : 0 });
+        if (c.kind == Utf8Kind || c.kind == BinaryKind) {
+            buffers.append({ reinterpret_cast<const char *>(c.offsets.constData()),
+                             c.offsets.size() * qint64(sizeof(qint32)) });
+        }
+        buffers.append({ c.values.constData(), c.values.size() });
+    }
+
+    QByteArray layout;
+    qint64 bodyLength = 0;
+    for (const auto &buffer : buffers) {
+        qAppendLittleEndian<qint64>(layout, bodyLength);
+        qAppendLittleEndian<qint64>(layout, buffer.size);
+        bodyLength += (buffer.size + 7) & ~qint64(7);
+    }
+
+    QMdbToolsFlatRef batch = qFlatTable();
+    batch->add(0, 8, quint64(m_batchRows))
+            .add(1, qFlatStructs(nodes, m_columns.size()))
+            .add(2, qFlatStructs(layout, buffers.size()));
+    qAppendArrowMessage(m_buf, ArrowRecordBatchHeader, batch, bodyLength);
+
+    for (const auto &buffer : buffers) {
+        m_buf.append(buffer.data, int(buffer.size));
+        qAlignBuffer(m_buf, 8);
+    }
+    resetBatch();
+}
+
+/************************************************************/
+/// Exports all rows of table, read with the handle mdb.
+/// \return true on success, otherwise false and error is set
+bool QMdbToolsExporter::exportTable(MdbHandle *mdb, const QString &tableName, const QString &fileName,
+                                    Format format, const QAtomicInt *stop, QString *error)
+{
+    auto table = mdb_read_table_by_name(mdb, const_cast<char *>(qUtf8Printable(tableName)), MDB_TABLE);
+    if (!table) {
+        *error = QString::fromLatin1("Table %1 does not exist").arg(tableName);
+        return false;
+    }
+    mdb_read_columns(table);
+
+    // only OLE values need a bound buffer, everything else is read from the page
+    QList<MdbColumn*> cols;
+    QVector<QByteArray> bindBuffers;
+    bindBuffers.reserve(int(table->num_cols));
+    for (uint i = 0; i < table->num_cols; i++) {
+        MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(table->columns, i));
+        cols << col;
+        if (col->col_type == MDB_OLE) {
+            bindBuffers.append(QByteArray(MDB_BIND_SIZE, '\0'));
+            mdb_bind_column(table, int(i) + 1, bindBuffers.last().data(), Q_NULLPTR);
+        }
+    }
+
+    QMdbToolsExporter exporter(mdb, table, cols, format);
+    const bool ok = exporter.run(fileName, stop, error);
+    mdb_free_tabledef(table);
+    return ok;
+}
+
+/************************************************************/
+/// Exports one table of a database file with its own libmdb handle
+class QMdbToolsExportTask : public QRunnable
+{
+public:
+    QMdbToolsExportTask(const QString &dbFile, const QString &table, const QString &fileName,
+                        QMdbToolsExporter::Format format, const QAtomicInt *stop, QString *error)
+        : m_dbFile(dbFile), m_table(table), m_fileName(fileName)
+        , m_format(format), m_stop(stop), m_error(error)
+    {
+    }
+
+    void run() override {
+        MdbHandle *mdb = mdb_open(qPrintable(m_dbFile), MDB_NOFLAGS);
+        if (!mdb || !mdb_read_catalog(mdb, MDB_TABLE)) {
+            *m_error = QString::fromLatin1("Cannot open %1").arg(m_dbFile);
+        } else {
+            QMdbToolsExporter::exportTable(mdb, m_table, m_fileName, m_format, m_stop, m_error);
+        }
+        if (mdb)
+            mdb_close(mdb);
+    }
+
+private:
+    QString m_dbFile;
+    QString m_table;
+    QString m_fileName;
+    QMdbToolsExporter::Format m_format;
+    const QAtomicInt *m_stop;
+    QString *m_error;
+};
+
+/************************************************************/
+/// Exports tables of dbFile into dirName in parallel, one file per table.
+/// \return true on success, otherwise false and errors lists the failed tables
+bool QMdbToolsExporter::exportTables(const QString &dbFile, const QStringList &tables, const QString &dirName,
+                                     Format format, const QAtomicInt *stop, QStringList *errors)
+{
+    const QDir dir(dirName);
+    QVector<QString> tableErrors(tables.size());
+    QThreadPool pool;
+    for (int i = 0; i < tables.size(); ++i) {
+        QString name = tables.at(i);
+        name.replace(QLatin1Char('/'), QLatin1Char('_')).replace(QLatin1Char('\\'), QLatin1Char('_'));
+        const QString fileName = dir.filePath(name + QLatin1Char('.') + fileSuffix(format));
+        pool.start(new QMdbToolsExportTask(dbFile, tables.at(i), fileName, format, stop, &tableErrors[i]));
+    }
+    pool.waitForDone();
+
+    bool ok = true;
+    for (int i = 0; i < tables.size(); ++i) {
+        if (tableErrors.at(i).isEmpty())
+            continue;
+        errors->append(tables.at(i) + QLatin1String(": ") + tableErrors.at(i));
+        ok = false;
+    }
+    return ok;
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
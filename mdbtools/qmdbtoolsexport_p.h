@@ -0,0 +1,82 @@
+#ifndef QMDBTOOLSEXPORT_P_H
+#define QMDBTOOLSEXPORT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+class QSaveFile;
+
+/// Writes the rows of a table scan to a CSV file or an Arrow IPC stream file.
+/// Values are converted from the page buffer straight into the output encoding,
+/// Arrow columns are collected in record batches. The output is written in large blocks.
+class QMdbToolsExporter
+{
+public:
+    enum Format { CsvFormat, ArrowFormat };
+
+    QMdbToolsExporter(MdbHandle *mdb, MdbTableDef *table, const QList<MdbColumn*> &cols, Format format);
+
+    bool run(const QString &fileName, const QAtomicInt *stop, QString *error);
+    qint64 rowCount() const { return m_rows; }
+
+    static QString fileSuffix(Format format);
+    static bool exportTable(MdbHandle *mdb, const QString &table, const QString &fileName,
+                            Format format, const QAtomicInt *stop, QString *error);
+    static bool exportTables(const QString &dbFile, const QStringList &tables, const QString &dirName,
+                             Format format, const QAtomicInt *stop, QStringList *errors);
+
+private:
+    struct Column {
+        MdbColumn *col = Q_NULLPTR;
+        int kind = 0;
+        bool shortDate = false;
+        QByteArray validity;      ///< Arrow validity bitmap of the batch, a set bit marks a value
+        QByteArray values;        ///< fixed-width values, bool bits or variable-width data of the batch
+        QVector<qint32> offsets;  ///< little endian offsets into values of variable-width columns
+        qint64 nullCount = 0;
+    };
+
+    void appendVariable(const Column &c, QByteArray &out) const;
+    void appendInt(int value);
+    void appendDate(double value, bool shortDate);
+    void writeCsvHeader();
+    void appendCsvRow();
+    void writeArrowSchema();
+    void appendArrowRow();
+    void writeArrowBatch();
+    void resetBatch();
+    bool flush();
+
+    MdbHandle *m_mdb;
+    MdbTableDef *m_table;
+    Format m_format;
+    QVector<Column> m_columns;
+    QByteArray m_buf;            ///< output not yet written to the file
+    QByteArray m_cell;
+    QSaveFile *m_file = Q_NULLPTR;
+    qint64 m_rows = 0;
+    int m_batchRows = 0;
+    qint64 m_batchBytes = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSEXPORT_P_H
@@ -0,0 +1,136 @@
+#include "qmdbtoolsfingerprint_p.h"
+#include "qmdbtoolspagedecoder_p.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+QT_BEGIN_NAMESPACE
+
+static const quint32 FingerprintMagic = 0x50464d51; // "QMFP"
+static const quint32 FingerprintVersion = 2;
+
+/************************************************************/
+/// 64 bit FNV-1a hash of data, never 0
+quint64 QMdbToolsTableFingerprint::hash(const unsigned char *data, int len)
+{
+    quint64 h = Q_UINT64_C(0xcbf29ce484222325);
+    for (int i = 0; i < len; ++i) {
+        h ^= data[i];
+        h *= Q_UINT64_C(0x100000001b3);
+    }
+    return h ? h : 1;
+}
+
+/************************************************************/
+/// Hashes the bytes of every row slot of the data page page
+QVector<quint64> QMdbToolsTableFingerprint::rowHashes(MdbHandle *mdb, const unsigned char *page)
+{
+    const int rco      = mdb->fmt->row_count_offset;
+    const int pageSize = mdb->fmt->pg_size;
+    const int rows     = qFromLittleEndian<quint16>(page + rco);
+
+    QVector<quint64> res(rows, 0);
+    int nextStart = pageSize;
+    for (int r = 0; r < rows; ++r) {
+        const int offset = qFromLittleEndian<quint16>(page + rco + 2 + r * 2);
+        const int start  = QMdbToolsPageDecoder::rowStart(offset);
+        const int end    = nextStart;
+        nextStart = start;
+        if (QMdbToolsPageDecoder::isDeletedRow(offset))
+            continue;
+        if (start >= end || end > pageSize)
+            continue;
+        res[r] = hash(page + start, end - start);
+    }
+    return res;
+}
+
+/************************************************************/
+/// Reads the serialized fingerprints of all tables in the state file fileName.
+/// A missing file or a file of an older version holds no tables. \return false if the file cannot be read
+static bool qReadStateFile(const QString &fileName, QMap<QString, QByteArray> *tables)
+{
+    tables->clear();
+    QFile file(fileName);
+    if (!file.exists())
+        return true;
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != FingerprintMagic || version > FingerprintVersion)
+        return false;
+    // a version 1 file held a single table, that table is synced again from scratch
+    if (version < FingerprintVersion)
+        return true;
+    in >> *tables;
+    if (in.status() != QDataStream::Ok) {
+        tables->clear();
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Loads the fingerprints saved by the last sync of table.
+/// \return NotFound if table was never synced into fileName, Invalid if the file is not a state file
+QMdbToolsTableFingerprint::LoadStatus QMdbToolsTableFingerprint::load(const QString &fileName, const QString &table)
+{
+    QMap<QString, QByteArray> tables;
+    if (!qReadStateFile(fileName, &tables))
+        return Invalid;
+    auto it = tables.constFind(table);
+    if (it == tables.constEnd())
+        return NotFound;
+
+    QDataStream in(it.value());
+    in >> fileKey.size >> fileKey.mtime >> fileKey.inode >> fileKey.checksum;
+    quint32 count = 0;
+    in >> count;
+    pages.clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint32 number = 0;
+        Page page;
+        in >> number >> page.checksum >> page.rowHashes >> page.keys;
+        pages.insert(number, page);
+    }
+    if (in.status() != QDataStream::Ok) {
+        pages.clear();
+        fileKey = QMdbToolsFileKey();
+        return Invalid;
+    }
+    return Loaded;
+}
+
+/************************************************************/
+/// Stores the fingerprints of table in fileName, the other tables of the file are kept
+bool QMdbToolsTableFingerprint::save(const QString &fileName, const QString &table) const
+{
+    QMap<QString, QByteArray> tables;
+    qReadStateFile(fileName, &tables);
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << fileKey.size << fileKey.mtime << fileKey.inode << fileKey.checksum
+        << quint32(pages.size());
+    for (auto it = pages.constBegin(); it != pages.constEnd(); ++it)
+        out << it.key() << it->checksum << it->rowHashes << it->keys;
+    tables.insert(table, data);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream stream(&file);
+    stream << FingerprintMagic << FingerprintVersion << tables;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+    return file.commit();
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
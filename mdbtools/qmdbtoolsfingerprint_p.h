@@ -0,0 +1,52 @@
+#ifndef QMDBTOOLSFINGERPRINT_P_H
+#define QMDBTOOLSFINGERPRINT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmdbtoolssnapshot_p.h"
+
+#include <QMap>
+#include <QVariant>
+#include <QVector>
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+/// Fingerprints of the data pages of a table as seen by the last sync:
+/// a checksum per page and a hash and primary key per row slot.
+/// Pages with an unchanged checksum are not decoded again by the next sync.
+/// A state file holds the fingerprints of any number of tables, keyed by table name.
+class QMdbToolsTableFingerprint
+{
+public:
+    enum LoadStatus { Loaded, NotFound, Invalid };
+
+    struct Page {
+        quint64 checksum = 0;
+        QVector<quint64> rowHashes;  ///< per row slot, 0 for deleted rows
+        QVector<QVariantList> keys;  ///< primary key per row slot, empty if the table has no primary key
+    };
+
+    static quint64 hash(const unsigned char *data, int len);
+    static QVector<quint64> rowHashes(MdbHandle *mdb, const unsigned char *page);
+
+    LoadStatus load(const QString &fileName, const QString &table);
+    bool save(const QString &fileName, const QString &table) const;
+
+    QMdbToolsFileKey fileKey;        ///< identity of the database file at the last sync
+    QMap<quint32, Page> pages;       ///< by page number
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSFINGERPRINT_P_H
@@ -0,0 +1,283 @@
+#include "qmdbtoolspagedecoder_p.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+/************************************************************/
+
+bool QMdbToolsColumnBatch::isInteger() const
+{
+    switch (col->col_type) {
+    case MDB_BOOL:
+    case MDB_BYTE:
+    case MDB_INT:
+    case MDB_LONGINT:
+        return true;
+    }
+    return false;
+}
+
+/************************************************************/
+
+QMdbToolsColumnStore::QMdbToolsColumnStore(const QList<MdbColumn*> &cols, const QVector<bool> &shortDate)
+{
+    m_columns.resize(cols.size());
+    for (int i = 0; i < cols.size(); ++i) {
+        m_columns[i].type = cols.at(i)->col_type;
+        m_columns[i].shortDate = shortDate.value(i);
+    }
+}
+
+/************************************************************/
+/// Appends the rows of a decoded page, batches are in column order
+void QMdbToolsColumnStore::append(const QVector<QMdbToolsColumnBatch> &batches, int rows)
+{
+    const int first = m_rows;
+    m_rows += rows;
+    for (int c = 0; c < m_columns.size(); ++c) {
+        Column &column = m_columns[c];
+        const QMdbToolsColumnBatch &batch = batches.at(c);
+        if (batch.isInteger())
+            column.ints += batch.ints;
+        else
+            column.reals += batch.reals;
+        column.nulls.resize(m_rows);
+        for (int r = 0; r < rows; ++r) {
+            if (batch.isNull(r))
+                column.nulls.setBit(first + r);
+        }
+    }
+}
+
+/************************************************************/
+/// Memory held by the values
+qint64 QMdbToolsColumnStore::byteSize() const
+{
+    qint64 res = 0;
+    for (const auto &column : m_columns) {
+        res += column.ints.size() * qint64(sizeof(qint32))
+                + column.reals.size() * qint64(sizeof(double))
+                + column.nulls.size() / 8;
+    }
+    return res;
+}
+
+/************************************************************/
+
+QMdbToolsPageDecoder::QMdbToolsPageDecoder(MdbHandle *mdb, const QList<MdbColumn*> &cols)
+    : m_mdb(mdb)
+    , m_colCountSize(IS_JET3(mdb) ? 1 : 2)
+{
+    m_columns.resize(cols.size());
+    for (int i = 0; i < cols.size(); ++i)
+        m_columns[i].col = cols.at(i);
+}
+
+/************************************************************/
+/// Returns true if the values of col can be extracted by the page decoder
+bool QMdbToolsPageDecoder::canDecode(MdbColumn *col)
+{
+    if (!col)
+        return false;
+    switch (col->col_type) {
+    case MDB_BOOL:
+    case MDB_BYTE:
+    case MDB_INT:
+    case MDB_LONGINT:
+    case MDB_FLOAT:
+    case MDB_DOUBLE:
+    case MDB_DATETIME:
+        return true;
+    }
+    return false;
+}
+
+/************************************************************/
+/// Decodes all live rows of the data page page.
+/// \return number of decoded rows
+int QMdbToolsPageDecoder::decodePage(const unsigned char *page)
+{
+    const int rco      = m_mdb->fmt->row_count_offset;
+    const int pageSize = m_mdb->fmt->pg_size;
+    const int rows     = qFromLittleEndian<quint16>(page + rco);
+
+    m_rowStarts.clear();
+    m_rowEnds.clear();
+    m_bytes = 0;
+
+    int nextStart = pageSize;
+    for (int r = 0; r < rows; ++r) {
+        const int offset = qFromLittleEndian<quint16>(page + rco + 2 + r * 2);
+        const int start  = rowStart(offset);
+        const int end    = nextStart - 1;
+        nextStart = start;
+        if (isDeletedRow(offset))
+            continue;
+        if (start >= end || end >= pageSize)
+            continue;
+        m_rowStarts.append(start);
+        m_rowEnds.append(end);
+    }
+
+    for (auto &batch : m_columns)
+        decodeColumn(page, batch);
+
+    return m_rowStarts.size();
+}
+
+/************************************************************/
+
+void QMdbToolsPageDecoder::decodeColumn(const unsigned char *page, QMdbToolsColumnBatch &batch)
+{
+    MdbColumn *col = batch.col;
+    const int rows = m_rowStarts.size();
+    const int colNum = col->col_num;
+    const int colStart = col->fixed_offset + m_colCountSize;
+
+    // null bitmap and value offsets
+    batch.nulls.fill(0, (rows + 7) / 8);
+    m_valueOffsets.resize(rows);
+    quint8 *nulls = batch.nulls.data();
+    int *offsets = m_valueOffsets.data();
+    for (int r = 0; r < rows; ++r) {
+        const int start = m_rowStarts.at(r);
+        const int end   = m_rowEnds.at(r);
+        const int rowCols = (m_colCountSize == 1) ? page[start] : qFromLittleEndian<quint16>(page + start);
+        const int nullMaskStart = end - (rowCols + 7) / 8 + 1;
+        // logic on nulls is reverse, 1 is not null, 0 is null
+        const bool present = colNum < rowCols && (page[nullMaskStart + colNum / 8] & (1 << (colNum % 8)));
+        offsets[r] = present ? start + colStart : -1;
+        if (col->col_type == MDB_BOOL)
+            continue;
+        if (!present || start + colStart + col->col_size > nullMaskStart) {
+            nulls[r >> 3] |= quint8(1 << (r & 7));
+            offsets[r] = -1;
+        }
+    }
+
+    // values, one loop per type
+    if (batch.isInteger()) {
+        batch.ints.resize(rows);
+        batch.reals.clear();
+    } else {
+        batch.reals.resize(rows);
+        batch.ints.clear();
+    }
+    qint32 *ints  = batch.ints.data();
+    double *reals = batch.reals.data();
+    switch (col->col_type) {
+    case MDB_BOOL:
+        // the value of a bool column is its null bit
+        for (int r = 0; r < rows; ++r)
+            ints[r] = offsets[r] >= 0;
+        return;
+    case MDB_BYTE:
+        for (int r = 0; r < rows; ++r)
+            ints[r] = offsets[r] >= 0 ? page[offsets[r]] : 0;
+        break;
+    case MDB_INT:
+        for (int r = 0; r < rows; ++r)
+            ints[r] = offsets[r] >= 0 ? qFromLittleEndian<qint16>(page + offsets[r]) : 0;
+        break;
+    case MDB_LONGINT:
+        for (int r = 0; r < rows; ++r)
+            ints[r] = offsets[r] >= 0 ? qFromLittleEndian<qint32>(page + offsets[r]) : 0;
+        break;
+    case MDB_FLOAT:
+        for (int r = 0; r < rows; ++r)
+            reals[r] = offsets[r] >= 0 ? qFromLittleEndian<float>(page + offsets[r]) : 0.0;
+        break;
+    default: // MDB_DOUBLE, MDB_DATETIME
+        for (int r = 0; r < rows; ++r)
+            reals[r] = offsets[r] >= 0 ? qFromLittleEndian<double>(page + offsets[r]) : 0.0;
+        break;
+    }
+    for (int r = 0; r < rows; ++r) {
+        if (offsets[r] >= 0)
+            m_bytes += col->col_size;
+    }
+}
+
+/************************************************************/
+/// Builds a QString from Jet4 text (UCS-2 little endian or Access "unicode compression").
+/// Compressed text starts with 0xFF 0xFE; each 0x00 toggles between one byte (Latin-1)
+/// and two byte characters.
+QString QMdbToolsPageDecoder::decodeText(const unsigned char *src, int len)
+{
+    if (len >= 2 && src[0] == 0xff && src[1] == 0xfe) {
+        src += 2;
+        len -= 2;
+        if (!memchr(src, 0, len)) {
+            // whole string is compressed
+            return QString::fromLatin1(reinterpret_cast<const char *>(src), len);
+        }
+        QString res(len, Qt::Uninitialized);
+        QChar *dst = res.data();
+        bool compressed = true;
+        int i = 0;
+        while (i < len) {
+            if (src[i] == 0) {
+                compressed = !compressed;
+                i++;
+            } else if (compressed) {
+                *dst++ = QChar(ushort(src[i++]));
+            } else if (i + 1 < len) {
+                *dst++ = QChar(qFromLittleEndian<quint16>(src + i));
+                i += 2;
+            } else {
+                break;
+            }
+        }
+        res.truncate(int(dst - res.constData()));
+        return res;
+    }
+
+    QString res(len / 2, Qt::Uninitialized);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    memcpy(res.data(), src, (len / 2) * sizeof(QChar));
+#else
+    QChar *dst = res.data();
+    for (int i = 0; i + 1 < len; i += 2)
+        *dst++ = QChar(qFromLittleEndian<quint16>(src + i));
+#endif
+    return res;
+}
+
+/************************************************************/
+/// Returns the text of a TEXT, MEMO or other variable-width column of the current row.
+/// Jet4 text and memos stored in the row are decoded from the page, everything else
+/// is converted by libmdb.
+QString QMdbToolsPageDecoder::columnText(MdbHandle *mdb, MdbColumn *col)
+{
+    const int start = col->cur_value_start;
+    const int len   = col->cur_value_len;
+    if (!IS_JET3(mdb)) {
+        if (col->col_type == MDB_TEXT)
+            return decodeText(mdb->pg_buf + start, len);
+
+        // memo stored in the row itself
+        if (col->col_type == MDB_MEMO && len > MDB_MEMO_OVERHEAD && (mdb_get_int32(mdb->pg_buf, start) & 0x80000000))
+            return decodeText(mdb->pg_buf + start + MDB_MEMO_OVERHEAD, len - MDB_MEMO_OVERHEAD);
+    }
+
+    // memo stored in long value pages
+    char *text = mdb_col_to_string(mdb, mdb->pg_buf, start, col->col_type, len);
+    QString res = QString::fromUtf8(text);
+    g_free(text);
+    return res;
+}
+
+/************************************************************/
+/// Returns true if the DATETIME column col holds dates without a time of day
+bool QMdbToolsPageDecoder::isShortDate(MdbColumn *col)
+{
+    const char *format = mdb_col_get_prop(col, "Format");
+    return format && !strcmp(format, "Short Date");
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
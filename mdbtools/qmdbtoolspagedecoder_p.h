@@ -0,0 +1,114 @@
+#ifndef QMDBTOOLSPAGEDECODER_P_H
+#define QMDBTOOLSPAGEDECODER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QBitArray>
+#include <QVector>
+#include <QList>
+#include <QString>
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+/// Values of one fixed-width column for all rows of a data page
+struct QMdbToolsColumnBatch
+{
+    MdbColumn *col = Q_NULLPTR;
+    QVector<qint32> ints;   ///< BOOL, BYTE, INT, LONGINT values
+    QVector<double> reals;  ///< FLOAT, DOUBLE, DATETIME values
+    QVector<quint8> nulls;  ///< bitmap, a set bit marks a null value
+
+    bool isNull(int row) const {
+        return nulls.at(row >> 3) & (1 << (row & 7));
+    }
+    bool isInteger() const;
+};
+
+/// Decoded values of fixed-width columns for all rows of a result.
+/// Values are kept in typed arrays and converted only when they are read.
+class QMdbToolsColumnStore
+{
+public:
+    QMdbToolsColumnStore(const QList<MdbColumn*> &cols, const QVector<bool> &shortDate);
+
+    void append(const QVector<QMdbToolsColumnBatch> &batches, int rows);
+
+    int size() const { return m_rows; }
+    qint64 byteSize() const;
+
+    int columnType(int column) const { return m_columns.at(column).type; }
+    bool isShortDate(int column) const { return m_columns.at(column).shortDate; }
+    bool isNull(int column, int row) const { return m_columns.at(column).nulls.testBit(row); }
+    qint32 intValue(int column, int row) const { return m_columns.at(column).ints.at(row); }
+    double realValue(int column, int row) const { return m_columns.at(column).reals.at(row); }
+
+private:
+    struct Column {
+        int type = 0;
+        bool shortDate = false;
+        QVector<qint32> ints;
+        QVector<double> reals;
+        QBitArray nulls;        ///< a set bit marks a null value
+    };
+
+    QVector<Column> m_columns;
+    int m_rows = 0;
+};
+
+/// Decodes fixed-width columns of a whole data page at once.
+/// The row offset table is read once, then every column is extracted
+/// for all rows of the page in a single loop.
+class QMdbToolsPageDecoder
+{
+public:
+    QMdbToolsPageDecoder(MdbHandle *mdb, const QList<MdbColumn*> &cols);
+
+    /// Flags of an entry of the row offset table of a data page
+    enum RowEntry { RowOffsetMask = 0x1fff, RowDeleted = 0x4000, RowLookup = 0x8000 };
+
+    static int rowStart(int entry) { return entry & RowOffsetMask; }
+    /// Only deleted rows are skipped, rows with the lookup flag are read like mdb_read_row() does
+    static bool isDeletedRow(int entry) { return entry & RowDeleted; }
+    static bool canDecode(MdbColumn *col);
+    static QString decodeText(const unsigned char *src, int len);
+    static QString columnText(MdbHandle *mdb, MdbColumn *col);
+    static bool isShortDate(MdbColumn *col);
+
+    /// A bool column is never null, libmdb reports a set bit as a value length of 0
+    static bool boolValue(const MdbColumn *col) { return col->cur_value_len == 0; }
+    static bool isNullValue(const MdbColumn *col) {
+        return col->col_type != MDB_BOOL && col->cur_value_len == 0;
+    }
+
+    int decodePage(const unsigned char *page);
+
+    int rowCount() const { return m_rowStarts.size(); }
+    const QVector<QMdbToolsColumnBatch> &columns() const { return m_columns; }
+    qint64 bytesDecoded() const { return m_bytes; }
+
+private:
+    void decodeColumn(const unsigned char *page, QMdbToolsColumnBatch &batch);
+
+    MdbHandle *m_mdb;
+    int m_colCountSize;        ///< size of the column count at the row start (1 for Jet3, 2 for Jet4)
+    QVector<int> m_rowStarts;  ///< page offsets of the live rows
+    QVector<int> m_rowEnds;    ///< page offsets of the last byte of the live rows
+    QVector<int> m_valueOffsets; ///< page offsets of the column values, -1 for nulls
+    QVector<QMdbToolsColumnBatch> m_columns;
+    qint64 m_bytes = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSPAGEDECODER_P_H
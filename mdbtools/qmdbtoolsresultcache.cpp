@@ -0,0 +1,112 @@
+#include "qmdbtoolsresultcache_p.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+QT_BEGIN_NAMESPACE
+
+Q_GLOBAL_STATIC(QMdbToolsResultCache, resultCache)
+
+/************************************************************/
+
+QMdbToolsResultCache *QMdbToolsResultCache::instance()
+{
+    return resultCache();
+}
+
+/************************************************************/
+/// Collapses white space outside of quoted strings and [bracketed identifiers]
+/// and drops a trailing semicolon
+QString QMdbToolsResultCache::normalizedQuery(const QString &query)
+{
+    QString res;
+    res.reserve(query.size());
+    QChar quote;        // closing character of the quoted span being copied
+    bool space = false;
+    for (const QChar ch : query) {
+        if (!quote.isNull()) {
+            res += ch;
+            if (ch == quote)
+                quote = QChar();
+            continue;
+        }
+        if (ch.isSpace()) {
+            space = true;
+            continue;
+        }
+        if (space && !res.isEmpty())
+            res += QLatin1Char(' ');
+        space = false;
+        if (ch == QLatin1Char('\'') || ch == QLatin1Char('"'))
+            quote = ch;
+        else if (ch == QLatin1Char('['))
+            quote = QLatin1Char(']');
+        res += ch;
+    }
+    while (res.endsWith(QLatin1Char(';')))
+        res.chop(1);
+    return res.trimmed();
+}
+
+/************************************************************/
+
+QString QMdbToolsResultCache::key(const QString &query, const QString &dbFile, const QMdbToolsFileKey &fileKey)
+{
+    return QString::fromLatin1("%1|%2|%3|%4|%5")
+            .arg(QFileInfo(dbFile).absoluteFilePath())
+            .arg(fileKey.size)
+            .arg(fileKey.mtime)
+            .arg(fileKey.inode)
+            .arg(normalizedQuery(query));
+}
+
+/************************************************************/
+/// Sets the byte budget of the cache, 0 disables caching
+void QMdbToolsResultCache::setBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(int(qBound(Q_INT64_C(0), bytes / 1024, qint64(INT_MAX))));
+}
+
+/************************************************************/
+
+qint64 QMdbToolsResultCache::budget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return qint64(m_cache.maxCost()) * 1024;
+}
+
+/************************************************************/
+
+bool QMdbToolsResultCache::find(const QString &key, Entry *entry)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry *cached = m_cache.object(key);
+    if (!cached)
+        return false;
+    *entry = *cached;
+    return true;
+}
+
+/************************************************************/
+/// Caches entry; results larger than the budget are not cached
+void QMdbToolsResultCache::insert(const QString &key, const Entry &entry)
+{
+    QMutexLocker locker(&m_mutex);
+    const qint64 cost = entry.bytes / 1024 + 1;
+    if (cost > m_cache.maxCost())
+        return;
+    m_cache.insert(key, new Entry(entry), int(cost));
+}
+
+/************************************************************/
+
+void QMdbToolsResultCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
@@ -0,0 +1,60 @@
+#ifndef QMDBTOOLSRESULTCACHE_P_H
+#define QMDBTOOLSRESULTCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolsrowstore_p.h"
+#include "qmdbtoolssnapshot_p.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSqlRecord>
+
+QT_BEGIN_NAMESPACE
+
+/// Process wide cache of materialized SELECT results.
+/// Entries are keyed by the normalized SQL text, the database path and the file
+/// identity, so a changed file never hits. The rows are immutable once cached and
+/// shared between all results reading them. Least recently used entries are evicted
+/// when the byte budget is exceeded.
+class QMdbToolsResultCache
+{
+public:
+    struct Entry {
+        QSqlRecord record;
+        QSharedPointer<QMdbToolsRowStore> rows;
+        QSharedPointer<QMdbToolsColumnStore> columns;  ///< instead of rows for decoded page scans
+        qint64 bytes;
+    };
+
+    static QMdbToolsResultCache *instance();
+
+    static QString key(const QString &query, const QString &dbFile, const QMdbToolsFileKey &fileKey);
+    static QString normalizedQuery(const QString &query);
+
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    bool find(const QString &key, Entry *entry);
+    void insert(const QString &key, const Entry &entry);
+    void clear();
+
+private:
+    mutable QMutex m_mutex;
+    QCache<QString, Entry> m_cache;  ///< cost is in KiB
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSRESULTCACHE_P_H
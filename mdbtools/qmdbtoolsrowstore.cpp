@@ -0,0 +1,216 @@
+#include "qmdbtoolsrowstore_p.h"
+
+#include <QDataStream>
+#include <QDir>
+
+#include <QDebug>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+static const int SpillBatchRows = 1024;
+static const int MaxDictionarySize = 4096;
+static const int DictionarySampleRows = 1024;
+
+/************************************************************/
+
+QMdbToolsRowStore::QMdbToolsRowStore(qint64 memoryBudget)
+    : m_budget(memoryBudget)
+{
+}
+
+/************************************************************/
+
+QMdbToolsRowStore::~QMdbToolsRowStore()
+{
+}
+
+/************************************************************/
+/// Sets the memory budget in bytes (0 means no limit). Takes effect on the next append.
+void QMdbToolsRowStore::setMemoryBudget(qint64 bytes)
+{
+    m_budget = qMax(Q_INT64_C(0), bytes);
+}
+
+/************************************************************/
+/// Rough estimate of the memory held by a materialized value.
+qint64 QMdbToolsRowStore::valueSize(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::String:
+        return sizeof(QVariant) + value.toString().size() * sizeof(QChar);
+    case QVariant::ByteArray:
+        return sizeof(QVariant) + value.toByteArray().size();
+    default:
+        break;
+    }
+    return sizeof(QVariant);
+}
+
+/************************************************************/
+/// Rough estimate of the memory held by a materialized row.
+qint64 QMdbToolsRowStore::rowSize(const QVariantList &row)
+{
+    qint64 res = sizeof(QVariantList);
+    for (const auto &value : row)
+        res += valueSize(value);
+    return res;
+}
+
+/************************************************************/
+
+void QMdbToolsRowStore::append(QVariantList row)
+{
+    encode(row);
+    m_tail.append(row);
+    m_tailBytes += rowSize(row);
+    if (m_budget > 0 && m_tailBytes > m_budget)
+        spill();
+}
+
+/************************************************************/
+/// Returns the row at index with encoded text values; the index must be valid.
+/// The reference stays valid until the next call of row(), append() or clear().
+const QVariantList &QMdbToolsRowStore::row(int index)
+{
+    if (index >= m_spilledRows)
+        return m_tail.at(index - m_spilledRows);
+
+    auto it = std::upper_bound(m_batches.cbegin(), m_batches.cend(), index,
+                               [](int idx, const Batch &batch) { return idx < batch.firstRow; });
+    const int batchIdx = int(it - m_batches.cbegin()) - 1;
+    if (batchIdx != m_loadedBatch && !load(batchIdx)) {
+        static const QVariantList empty;
+        return empty;
+    }
+    return m_loaded.at(index - m_batches.at(batchIdx).firstRow);
+}
+
+/************************************************************/
+/// Returns the value at column of the row at index with dictionary codes resolved.
+QVariant QMdbToolsRowStore::value(int index, int column)
+{
+    const QVariant value = row(index).value(column);
+    if (value.type() == QVariant::UInt && column < m_dicts.size() && m_dicts.at(column).encoded)
+        return m_dicts.at(column).values.value(value.toUInt());
+    return value;
+}
+
+/************************************************************/
+/// Replaces text values by dictionary codes while the column looks low-cardinality.
+/// Only columns holding nothing but text and nulls are encoded.
+void QMdbToolsRowStore::encode(QVariantList &row)
+{
+    if (m_dicts.size() < row.size())
+        m_dicts.resize(row.size());
+
+    const int rows = size();
+    for (int i = 0; i < row.size(); ++i) {
+        Dictionary &dict = m_dicts[i];
+        if (!dict.active)
+            continue;
+        if (row.at(i).type() != QVariant::String) {
+            // codes could not be told from values of other types
+            if (!row.at(i).isNull() && !dict.encoded) {
+                dict.active = false;
+                dict.codes.clear();
+            }
+            continue;
+        }
+
+        const QString text = row.at(i).toString();
+        auto it = dict.codes.constFind(text);
+        if (it == dict.codes.constEnd()) {
+            // too many distinct values, keep the codes already handed out
+            if (dict.values.size() >= MaxDictionarySize
+                    || (rows >= DictionarySampleRows && dict.values.size() > rows / 2)) {
+                dict.active = false;
+                dict.codes.clear();
+                dict.codes.squeeze();
+                continue;
+            }
+            it = dict.codes.insert(text, uint(dict.values.size()));
+            dict.values.append(text);
+        }
+        dict.encoded = true;
+        row[i] = QVariant(it.value());
+    }
+}
+
+/************************************************************/
+
+void QMdbToolsRowStore::clear()
+{
+    m_tail.clear();
+    m_tailBytes = 0;
+    m_spilledRows = 0;
+    m_batches.clear();
+    m_loaded.clear();
+    m_loadedBatch = -1;
+    m_file.reset();
+    m_dicts.clear();
+}
+
+/************************************************************/
+/// Writes the rows kept in memory to the temporary file
+void QMdbToolsRowStore::spill()
+{
+    if (!m_file) {
+        m_file.reset(new QTemporaryFile(QDir::tempPath() + QLatin1String("/qmdbtools-XXXXXX.rows")));
+        if (!m_file->open()) {
+            qWarning() << "QMdbToolsRowStore: cannot create spill file" << m_file->errorString();
+            m_file.reset();
+            m_budget = 0;
+            return;
+        }
+    }
+
+    const int batchCount = m_batches.size();
+    qint64 offset = m_file->size();
+    m_file->seek(offset);
+    for (int first = 0; first < m_tail.size(); first += SpillBatchRows) {
+        const int count = qMin(SpillBatchRows, m_tail.size() - first);
+        QByteArray buf;
+        QDataStream out(&buf, QIODevice::WriteOnly);
+        out << m_tail.mid(first, count);
+        if (m_file->write(buf) != buf.size()) {
+            qWarning() << "QMdbToolsRowStore: cannot write spill file" << m_file->errorString();
+            m_batches.resize(batchCount);
+            m_budget = 0;
+            return;
+        }
+        m_batches.append({ m_spilledRows + first, count, offset, buf.size() });
+        offset += buf.size();
+    }
+    m_spilledRows += m_tail.size();
+    m_tail.clear();
+    m_tailBytes = 0;
+}
+
+/************************************************************/
+/// Reads a spilled batch back into memory
+bool QMdbToolsRowStore::load(int batchIdx)
+{
+    const Batch &batch = m_batches.at(batchIdx);
+    m_loaded.clear();
+    m_loadedBatch = -1;
+    if (!m_file->seek(batch.offset)) {
+        qWarning() << "QMdbToolsRowStore: cannot seek spill file" << m_file->errorString();
+        return false;
+    }
+    const QByteArray buf = m_file->read(batch.length);
+    QDataStream in(buf);
+    in >> m_loaded;
+    if (in.status() != QDataStream::Ok || m_loaded.size() != batch.count) {
+        qWarning() << "QMdbToolsRowStore: corrupted spill file";
+        m_loaded.clear();
+        return false;
+    }
+    m_loadedBatch = batchIdx;
+    return true;
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
@@ -0,0 +1,81 @@
+#ifndef QMDBTOOLSROWSTORE_P_H
+#define QMDBTOOLSROWSTORE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QVariant>
+#include <QVector>
+#include <QHash>
+#include <QTemporaryFile>
+#include <QScopedPointer>
+
+QT_BEGIN_NAMESPACE
+
+/// Materialized rows of a result.
+/// Rows are kept in memory until the memory budget is exceeded; older rows are then
+/// written in batches to a temporary file and read back batch by batch on access.
+/// Text values of low-cardinality columns are stored as codes into a per-column dictionary.
+class QMdbToolsRowStore
+{
+public:
+    explicit QMdbToolsRowStore(qint64 memoryBudget = 0);
+    ~QMdbToolsRowStore();
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return m_budget; }
+
+    void append(QVariantList row);
+    const QVariantList &row(int index);
+    QVariant value(int index, int column);
+    void clear();
+
+    int size() const { return m_spilledRows + m_tail.size(); }
+    bool isEmpty() const { return size() == 0; }
+    bool isSpilled() const { return m_spilledRows > 0; }
+
+    static qint64 valueSize(const QVariant &value);
+    static qint64 rowSize(const QVariantList &row);
+
+private:
+    struct Dictionary {
+        QVector<QString> values;    ///< distinct values, the code is the index
+        QHash<QString, uint> codes;
+        bool active = true;         ///< new values are encoded
+        bool encoded = false;       ///< unsigned values of the column are codes
+    };
+
+    void encode(QVariantList &row);
+
+    struct Batch {
+        int firstRow;
+        int count;
+        qint64 offset;
+        qint64 length;
+    };
+
+    void spill();
+    bool load(int batchIdx);
+
+    qint64 m_budget = 0;           ///< memory budget in bytes, 0 is unlimited
+    qint64 m_tailBytes = 0;        ///< estimated size of rows kept in memory
+    int m_spilledRows = 0;
+    QVector<QVariantList> m_tail;  ///< rows from m_spilledRows on
+    QVector<Batch> m_batches;      ///< index of spilled batches
+    int m_loadedBatch = -1;
+    QVector<QVariantList> m_loaded;
+    QScopedPointer<QTemporaryFile> m_file;
+    QVector<Dictionary> m_dicts;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSROWSTORE_P_H
@@ -0,0 +1,561 @@
+#include "qmdbtoolssnapshot_p.h"
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolstablescan_p.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QUrl>
+#include <QVector>
+#include <QtEndian>
+
+#include <QDebug>
+
+#include <cstring>
+
+#if defined Q_OS_UNIX
+# include <sys/stat.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+static const char SnapshotMagic[8] = { 'Q', 'M', 'D', 'B', 'S', 'N', 'A', 'P' };
+static const quint32 SnapshotVersion = 1;
+static const int SnapshotNameSize = 256;
+static const int HeaderPageSize = 4096;
+static const int SnapshotChunkSize = 64 * 1024;   ///< column data is spooled in chunks of this size
+
+struct QMdbToolsSnapshot::Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64 fileSize;
+    qint64 fileTime;
+    quint64 checksum;
+    qint64 rowCount;
+    qint32 columnCount;
+    qint32 reserved;
+};
+
+struct QMdbToolsSnapshot::Column
+{
+    char name[SnapshotNameSize];
+    qint32 type;
+    qint32 reserved;
+    qint64 nullsOffset;  ///< null bitmap
+    qint64 dataOffset;   ///< qint32 or double values, offsets into the text for text columns
+    qint64 textOffset;   ///< UTF-16 text of text columns
+};
+
+static qint64 qAlign8(qint64 value)
+{
+    return (value + 7) & ~qint64(7);
+}
+
+/************************************************************/
+/// Reads the identity of the database file fileName
+QMdbToolsFileKey QMdbToolsFileKey::fromFile(const QString &fileName)
+{
+    QMdbToolsFileKey key = fromStat(fileName);
+    QFile file(fileName);
+    if (!key.isValid() || !file.open(QIODevice::ReadOnly))
+        return QMdbToolsFileKey();
+    const QByteArray page = file.read(HeaderPageSize);
+    const QByteArray hash = QCryptographicHash::hash(page, QCryptographicHash::Sha1);
+    key.checksum = qFromLittleEndian<quint64>(hash.constData());
+    return key;
+}
+
+/************************************************************/
+/// Reads size, mtime and inode of fileName without reading the file
+QMdbToolsFileKey QMdbToolsFileKey::fromStat(const QString &fileName)
+{
+    QMdbToolsFileKey key;
+    const QFileInfo info(fileName);
+    if (!info.exists())
+        return key;
+    key.size = info.size();
+    key.mtime = info.lastModified().toMSecsSinceEpoch();
+#if defined Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(fileName).constData(), &st) == 0)
+        key.inode = quint64(st.st_ino);
+#endif
+    return key;
+}
+
+/************************************************************/
+
+QMdbToolsSnapshot::QMdbToolsSnapshot()
+{
+}
+
+/************************************************************/
+
+QMdbToolsSnapshot::~QMdbToolsSnapshot()
+{
+    close();
+}
+
+/************************************************************/
+/// Returns true if the values of col can be stored in a snapshot
+bool QMdbToolsSnapshot::canStore(MdbHandle *mdb, MdbColumn *col)
+{
+    if (QMdbToolsPageDecoder::canDecode(col))
+        return true;
+    return col && col->col_type == MDB_TEXT && !IS_JET3(mdb);
+}
+
+/************************************************************/
+/// Returns the sidecar file name of table of the database dbFile.
+/// Sidecar files are kept next to the database if dir is empty. The name contains a hash
+/// of the absolute database path, so databases with the same name can share dir.
+QString QMdbToolsSnapshot::fileName(const QString &dir, const QString &dbFile, const QString &table,
+                                    const QString &suffix)
+{
+    const QFileInfo info(dbFile);
+    const QString path = dir.isEmpty() ? info.absolutePath() : dir;
+    const QString name = QString::fromLatin1(QUrl::toPercentEncoding(table));
+    const QByteArray hash = QCryptographicHash::hash(QFile::encodeName(info.absoluteFilePath()),
+                                                     QCryptographicHash::Sha1).toHex().left(12);
+    return QDir(path).filePath(QString::fromLatin1("%1-%2.%3.%4")
+                               .arg(info.completeBaseName(), QString::fromLatin1(hash), name, suffix));
+}
+
+/************************************************************/
+/// Column data of a snapshot being built. Each column has a null bitmap, a data and a
+/// text stream; the streams are written in chunks to one temporary file, so the table
+/// is never held in memory.
+class QMdbToolsSnapshotSpool
+{
+public:
+    enum Stream { Nulls, Data, Text, StreamCount };
+
+    explicit QMdbToolsSnapshotSpool(int columns)
+        : m_file(QDir::tempPath() + QLatin1String("/qmdbtools-XXXXXX.snap"))
+        , m_buffers(columns * StreamCount)
+        , m_chunks(columns * StreamCount)
+        , m_sizes(columns * StreamCount, 0)
+    {
+    }
+
+    bool open() { return m_file.open(); }
+    QString errorString() const { return m_file.errorString(); }
+
+    QByteArray &buffer(int column, Stream stream) { return m_buffers[column * StreamCount + stream]; }
+    qint64 size(int column, Stream stream) const {
+        const int idx = column * StreamCount + stream;
+        return m_sizes.at(idx) + m_buffers.at(idx).size();
+    }
+
+    bool flush(int column, Stream stream, bool force = false);
+    bool copy(int column, Stream stream, QIODevice *out);
+
+private:
+    struct Chunk {
+        qint64 offset;
+        qint64 length;
+    };
+
+    QTemporaryFile m_file;
+    QVector<QByteArray> m_buffers;
+    QVector<QVector<Chunk>> m_chunks;
+    QVector<qint64> m_sizes;       ///< bytes of the stream in the temporary file
+};
+
+/************************************************************/
+/// Writes the buffer of a stream to the temporary file once it holds a chunk
+bool QMdbToolsSnapshotSpool::flush(int column, Stream stream, bool force)
+{
+    const int idx = column * StreamCount + stream;
+    QByteArray &buf = m_buffers[idx];
+    if (buf.isEmpty() || (!force && buf.size() < SnapshotChunkSize))
+        return true;
+    const qint64 offset = m_file.size();
+    if (!m_file.seek(offset) || m_file.write(buf) != buf.size())
+        return false;
+    m_chunks[idx].append({ offset, buf.size() });
+    m_sizes[idx] += buf.size();
+    buf.resize(0);
+    return true;
+}
+
+/************************************************************/
+/// Appends the whole stream to out
+bool QMdbToolsSnapshotSpool::copy(int column, Stream stream, QIODevice *out)
+{
+    if (!flush(column, stream, true))
+        return false;
+    for (const auto &chunk : m_chunks.at(column * StreamCount + stream)) {
+        if (!m_file.seek(chunk.offset))
+            return false;
+        const QByteArray buf = m_file.read(chunk.length);
+        if (buf.size() != chunk.length || out->write(buf) != buf.size())
+            return false;
+    }
+    return true;
+}
+
+/************************************************************/
+
+template <typename T>
+static void qAppendValue(QByteArray &buf, T value)
+{
+    buf.append(reinterpret_cast<const char *>(&value), int(sizeof(T)));
+}
+
+/************************************************************/
+/// Converts table into a snapshot file. The conversion stops when stop is set.
+/// \return true on success, otherwise false and error is set
+bool QMdbToolsSnapshot::build(MdbHandle *mdb, const QString &tableName, const QMdbToolsFileKey &key,
+                              const QString &fileName, const QAtomicInt *stop, QString *error)
+{
+    struct ColumnData {
+        MdbColumn *col;
+        quint8 nulls;         ///< null bits of the current 8 rows
+        qint64 textSize;      ///< UTF-16 code units written so far
+    };
+
+    auto table = mdb_read_table_by_name(mdb, const_cast<char *>(qUtf8Printable(tableName)), MDB_TABLE);
+    if (!table) {
+        *error = QString::fromLatin1("Table %1 does not exist").arg(tableName);
+        return false;
+    }
+    mdb_read_columns(table);
+
+    QVector<ColumnData> data;
+    for (uint i = 0; i < table->num_cols; i++) {
+        MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(table->columns, i));
+        if (canStore(mdb, col))
+            data.append({ col, 0, 0 });
+    }
+
+    QMdbToolsSnapshotSpool spool(data.size());
+    if (!spool.open()) {
+        mdb_free_tabledef(table);
+        *error = spool.errorString();
+        return false;
+    }
+    for (int c = 0; c < data.size(); ++c) {
+        if (data.at(c).col->col_type == MDB_TEXT)
+            qAppendValue<qint64>(spool.buffer(c, QMdbToolsSnapshotSpool::Data), 0);
+    }
+
+    qint64 rows = 0;
+    bool ok = true;
+    QMdbToolsTableScan scan(table, stop);
+    while (ok && scan.fetchRow()) {
+        for (int c = 0; c < data.size(); ++c) {
+            ColumnData &cd = data[c];
+            MdbColumn *col = cd.col;
+            QByteArray &out = spool.buffer(c, QMdbToolsSnapshotSpool::Data);
+            const bool isNull = QMdbToolsPageDecoder::isNullValue(col);
+            if (isNull)
+                cd.nulls |= quint8(1 << (rows % 8));
+            if (rows % 8 == 7) {
+                spool.buffer(c, QMdbToolsSnapshotSpool::Nulls).append(char(cd.nulls));
+                cd.nulls = 0;
+            }
+            const unsigned char *value = mdb->pg_buf + col->cur_value_start;
+            switch (col->col_type) {
+            case MDB_BOOL:
+                qAppendValue<qint32>(out, QMdbToolsPageDecoder::boolValue(col));
+                break;
+            case MDB_BYTE:
+                qAppendValue<qint32>(out, isNull ? 0 : value[0]);
+                break;
+            case MDB_INT:
+                qAppendValue<qint32>(out, isNull ? 0 : qFromLittleEndian<qint16>(value));
+                break;
+            case MDB_LONGINT:
+                qAppendValue<qint32>(out, isNull ? 0 : qFromLittleEndian<qint32>(value));
+                break;
+            case MDB_FLOAT:
+                qAppendValue<double>(out, isNull ? 0.0 : qFromLittleEndian<float>(value));
+                break;
+            case MDB_DOUBLE:
+            case MDB_DATETIME:
+                qAppendValue<double>(out, isNull ? 0.0 : qFromLittleEndian<double>(value));
+                break;
+            case MDB_TEXT:
+                if (!isNull) {
+                    const QString text = QMdbToolsPageDecoder::columnText(mdb, col);
+                    spool.buffer(c, QMdbToolsSnapshotSpool::Text)
+                            .append(reinterpret_cast<const char *>(text.constData()), text.size() * int(sizeof(QChar)));
+                    cd.textSize += text.size();
+                    ok = ok && spool.flush(c, QMdbToolsSnapshotSpool::Text);
+                }
+                qAppendValue<qint64>(out, cd.textSize);
+                break;
+            }
+            ok = ok && spool.flush(c, QMdbToolsSnapshotSpool::Data)
+                    && spool.flush(c, QMdbToolsSnapshotSpool::Nulls);
+        }
+        ++rows;
+    }
+    mdb_free_tabledef(table);
+    if (scan.status() == QMdbToolsTableScan::Stopped) {
+        *error = QString::fromUtf8("Snapshot cancelled");
+        return false;
+    }
+    if (!ok) {
+        *error = spool.errorString();
+        return false;
+    }
+    if (rows % 8) {
+        for (int c = 0; c < data.size(); ++c)
+            spool.buffer(c, QMdbToolsSnapshotSpool::Nulls).append(char(data.at(c).nulls));
+    }
+
+    // layout
+    qint64 pos = qAlign8(sizeof(Header) + data.size() * sizeof(Column));
+    QVector<Column> dir(data.size());
+    for (int c = 0; c < data.size(); ++c) {
+        Column &entry = dir[c];
+        memset(&entry, 0, sizeof(Column));
+        qstrncpy(entry.name, data.at(c).col->name, SnapshotNameSize);
+        entry.type = data.at(c).col->col_type;
+        entry.nullsOffset = pos;
+        pos = qAlign8(pos + spool.size(c, QMdbToolsSnapshotSpool::Nulls));
+        entry.dataOffset = pos;
+        pos = qAlign8(pos + spool.size(c, QMdbToolsSnapshotSpool::Data));
+        if (entry.type == MDB_TEXT) {
+            entry.textOffset = pos;
+            pos = qAlign8(pos + spool.size(c, QMdbToolsSnapshotSpool::Text));
+        }
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    header.version = SnapshotVersion;
+    header.byteOrder = Q_BYTE_ORDER;
+    header.fileSize = key.size;
+    header.fileTime = key.mtime;
+    header.checksum = key.checksum;
+    header.rowCount = rows;
+    header.columnCount = data.size();
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    auto pad = [&file]() {
+        static const char zeros[8] = { 0 };
+        file.write(zeros, qAlign8(file.pos()) - file.pos());
+    };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    file.write(reinterpret_cast<const char *>(dir.constData()), dir.size() * qint64(sizeof(Column)));
+    pad();
+    for (int c = 0; c < data.size() && ok; ++c) {
+        ok = spool.copy(c, QMdbToolsSnapshotSpool::Nulls, &file);
+        pad();
+        ok = ok && spool.copy(c, QMdbToolsSnapshotSpool::Data, &file);
+        pad();
+        if (dir.at(c).type == MDB_TEXT) {
+            ok = ok && spool.copy(c, QMdbToolsSnapshotSpool::Text, &file);
+            pad();
+        }
+    }
+    if (!ok || file.pos() != pos || !file.commit()) {
+        *error = ok ? file.errorString() : spool.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Maps the snapshot fileName; fails if it was built for a different version of the database
+/// or if its arrays do not fit into the file.
+bool QMdbToolsSnapshot::open(const QString &fileName, const QMdbToolsFileKey &key)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    if (m_file.size() < qint64(sizeof(Header))) {
+        close();
+        return false;
+    }
+    m_map = m_file.map(0, m_file.size());
+    if (!m_map) {
+        close();
+        return false;
+    }
+
+    const Header *hdr = header();
+    bool valid = !memcmp(hdr->magic, SnapshotMagic, sizeof(SnapshotMagic))
+            && hdr->version == SnapshotVersion
+            && hdr->byteOrder == Q_BYTE_ORDER
+            && hdr->fileSize == key.size
+            && hdr->fileTime == key.mtime
+            && hdr->checksum == key.checksum
+            && hdr->rowCount >= 0
+            && hdr->columnCount >= 0
+            && qint64(sizeof(Header)) + hdr->columnCount * qint64(sizeof(Column)) <= m_file.size();
+    for (int c = 0; valid && c < hdr->columnCount; ++c)
+        valid = isValidColumn(c);
+    if (!valid) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Checks that the name, the null bitmap, the values and the text of column lie within the file
+bool QMdbToolsSnapshot::isValidColumn(int c) const
+{
+    const qint64 size = m_file.size();
+    const qint64 rows = header()->rowCount;
+    const Column *col = column(c);
+    auto inFile = [size](qint64 offset, qint64 length) {
+        return offset >= 0 && offset % 8 == 0 && length >= 0 && offset <= size && length <= size - offset;
+    };
+
+    // every row takes at least a bit, larger counts would overflow below
+    if (!memchr(col->name, 0, SnapshotNameSize) || rows > size * 8)
+        return false;
+    if (!inFile(col->nullsOffset, (rows + 7) / 8))
+        return false;
+    switch (col->type) {
+    case MDB_BOOL:
+    case MDB_BYTE:
+    case MDB_INT:
+    case MDB_LONGINT:
+        return inFile(col->dataOffset, rows * qint64(sizeof(qint32)));
+    case MDB_FLOAT:
+    case MDB_DOUBLE:
+    case MDB_DATETIME:
+        return inFile(col->dataOffset, rows * qint64(sizeof(double)));
+    case MDB_TEXT:
+        break;
+    default:
+        return false;
+    }
+
+    if (!inFile(col->dataOffset, (rows + 1) * qint64(sizeof(qint64))))
+        return false;
+    const qint64 *offsets = reinterpret_cast<const qint64 *>(m_map + col->dataOffset);
+    if (offsets[0] != 0)
+        return false;
+    for (qint64 r = 0; r < rows; ++r) {
+        if (offsets[r + 1] < offsets[r] || offsets[r + 1] > size || offsets[r + 1] - offsets[r] > INT_MAX)
+            return false;
+    }
+    return inFile(col->textOffset, offsets[rows] * qint64(sizeof(QChar)));
+}
+
+/************************************************************/
+
+void QMdbToolsSnapshot::close()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+    m_map = Q_NULLPTR;
+    m_file.close();
+}
+
+/************************************************************/
+
+const QMdbToolsSnapshot::Header *QMdbToolsSnapshot::header() const
+{
+    return reinterpret_cast<const Header *>(m_map);
+}
+
+/************************************************************/
+
+const QMdbToolsSnapshot::Column *QMdbToolsSnapshot::column(int column) const
+{
+    return reinterpret_cast<const Column *>(m_map + sizeof(Header)) + column;
+}
+
+/************************************************************/
+
+qint64 QMdbToolsSnapshot::rowCount() const
+{
+    return header()->rowCount;
+}
+
+/************************************************************/
+
+int QMdbToolsSnapshot::columnCount() const
+{
+    return header()->columnCount;
+}
+
+/************************************************************/
+/// Returns the index of the column name (case insensitive) or -1 if it is not stored
+int QMdbToolsSnapshot::columnIndex(const QString &name) const
+{
+    const QByteArray utf8 = name.toUtf8();
+    for (int c = 0; c < columnCount(); ++c) {
+        if (!qstricmp(column(c)->name, utf8.constData()))
+            return c;
+    }
+    return -1;
+}
+
+/************************************************************/
+
+int QMdbToolsSnapshot::columnType(int c) const
+{
+    return column(c)->type;
+}
+
+/************************************************************/
+
+bool QMdbToolsSnapshot::isNull(int c, qint64 row) const
+{
+    const uchar *nulls = m_map + column(c)->nullsOffset;
+    return nulls[row >> 3] & (1 << (row & 7));
+}
+
+/************************************************************/
+
+qint32 QMdbToolsSnapshot::intValue(int c, qint64 row) const
+{
+    return reinterpret_cast<const qint32 *>(m_map + column(c)->dataOffset)[row];
+}
+
+/************************************************************/
+
+double QMdbToolsSnapshot::realValue(int c, qint64 row) const
+{
+    return reinterpret_cast<const double *>(m_map + column(c)->dataOffset)[row];
+}
+
+/************************************************************/
+
+QString QMdbToolsSnapshot::textValue(int c, qint64 row) const
+{
+    const Column *col = column(c);
+    const qint64 *offsets = reinterpret_cast<const qint64 *>(m_map + col->dataOffset);
+    const QChar *text = reinterpret_cast<const QChar *>(m_map + col->textOffset);
+    return QString(text + offsets[row], int(offsets[row + 1] - offsets[row]));
+}
+
+/************************************************************/
+
+void QMdbToolsSnapshotTask::run()
+{
+    MdbHandle *mdb = mdb_open(qPrintable(m_dbFile), MDB_NOFLAGS);
+    if (!mdb || !mdb_read_catalog(mdb, MDB_TABLE)) {
+        m_state->error = QString::fromLatin1("Cannot open %1").arg(m_dbFile);
+    } else {
+        m_state->ok = QMdbToolsSnapshot::build(mdb, m_table, m_key, m_fileName, m_stop, &m_state->error);
+    }
+    if (mdb)
+        mdb_close(mdb);
+    m_state->done.storeRelease(1);
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
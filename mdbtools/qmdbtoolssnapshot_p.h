@@ -0,0 +1,113 @@
+#ifndef QMDBTOOLSSNAPSHOT_P_H
+#define QMDBTOOLSSNAPSHOT_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QAtomicInt>
+#include <QFile>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QString>
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+/// Identity of a database file, a snapshot is valid for one identity only
+struct QMdbToolsFileKey
+{
+    qint64 size = -1;
+    qint64 mtime = 0;     ///< msecs since epoch
+    quint64 inode = 0;
+    quint64 checksum = 0; ///< of the database header page
+
+    static QMdbToolsFileKey fromFile(const QString &fileName);
+    static QMdbToolsFileKey fromStat(const QString &fileName);
+    bool isValid() const { return size >= 0; }
+    bool operator==(const QMdbToolsFileKey &other) const {
+        return size == other.size && mtime == other.mtime && inode == other.inode && checksum == other.checksum;
+    }
+};
+
+/// Columnar copy of a table stored in a sidecar file.
+/// Fixed-width columns are stored as qint32 or double arrays, Jet4 text columns
+/// as UTF-16 data with an offset array; every column has a null bitmap.
+/// The file is memory mapped when opened.
+class QMdbToolsSnapshot
+{
+public:
+    QMdbToolsSnapshot();
+    ~QMdbToolsSnapshot();
+
+    static bool canStore(MdbHandle *mdb, MdbColumn *col);
+    static QString fileName(const QString &dir, const QString &dbFile, const QString &table,
+                            const QString &suffix = QLatin1String("qmdbsnap"));
+    static bool build(MdbHandle *mdb, const QString &table, const QMdbToolsFileKey &key,
+                      const QString &fileName, const QAtomicInt *stop, QString *error);
+
+    bool open(const QString &fileName, const QMdbToolsFileKey &key);
+    void close();
+    bool isOpen() const { return m_map != Q_NULLPTR; }
+
+    qint64 rowCount() const;
+    int columnCount() const;
+    int columnIndex(const QString &name) const;
+    int columnType(int column) const;
+
+    bool isNull(int column, qint64 row) const;
+    qint32 intValue(int column, qint64 row) const;
+    double realValue(int column, qint64 row) const;
+    QString textValue(int column, qint64 row) const;
+
+private:
+    struct Header;
+    struct Column;
+
+    const Header *header() const;
+    const Column *column(int column) const;
+    bool isValidColumn(int column) const;
+
+    QFile m_file;
+    uchar *m_map = Q_NULLPTR;
+};
+
+/// Converts a table into a snapshot file in the background with its own libmdb handle
+class QMdbToolsSnapshotTask : public QRunnable
+{
+public:
+    struct State {
+        QAtomicInt done;  ///< set when ok and error are final
+        bool ok = false;
+        QString error;
+    };
+
+    QMdbToolsSnapshotTask(const QString &dbFile, const QString &table, const QMdbToolsFileKey &key,
+                          const QString &fileName, const QAtomicInt *stop, const QSharedPointer<State> &state)
+        : m_dbFile(dbFile), m_table(table), m_key(key), m_fileName(fileName)
+        , m_stop(stop), m_state(state)
+    {
+    }
+
+    void run() override;
+
+private:
+    QString m_dbFile;
+    QString m_table;
+    QMdbToolsFileKey m_key;
+    QString m_fileName;
+    const QAtomicInt *m_stop;
+    QSharedPointer<State> m_state;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSSNAPSHOT_P_H
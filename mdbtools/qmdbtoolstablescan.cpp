@@ -0,0 +1,146 @@
+#include "qmdbtoolstablescan_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/************************************************************/
+/// Starts a scan of table. The scan ends early when stop is set or when timer
+/// has run for more than timeout msecs.
+QMdbToolsTableScan::QMdbToolsTableScan(MdbTableDef *table, const QAtomicInt *stop,
+                                       const QElapsedTimer *timer, int timeout)
+    : m_table(table)
+    , m_stop(stop)
+    , m_timer(timer)
+    , m_timeout(timeout)
+    , m_byPage(table->strategy == MDB_TABLE_SCAN && !table->is_temp_table)
+{
+    if (m_byPage)
+        mdb_rewind_table(table);
+}
+
+/************************************************************/
+/// Moves to the next matching row and binds its values.
+/// \return false at the end of the table or when the scan was interrupted, see status()
+bool QMdbToolsTableScan::fetchRow()
+{
+    if (m_status != Running)
+        return false;
+
+    if (!m_byPage) {
+        if (isInterrupted())
+            return false;
+        if (mdb_fetch_row(m_table)) {
+            // the rows mdb_fetch_row() skipped are not visible here
+            ++m_rowsScanned;
+            return true;
+        }
+        m_status = Finished;
+        return false;
+    }
+
+    MdbHandle *mdb = m_table->entry->mdb;
+    forever {
+        while (m_row < m_rows) {
+            const int row = m_row++;
+            m_table->cur_row = m_row;
+            ++m_rowsScanned;
+            if (mdb_read_row(m_table, row))
+                return true;
+        }
+        if (isInterrupted())
+            return false;
+        if (!mdb_read_next_dpg(m_table)) {
+            m_status = Finished;
+            return false;
+        }
+        m_rows = mdb_get_int16(mdb->pg_buf, mdb->fmt->row_count_offset);
+        m_row = 0;
+    }
+}
+
+/************************************************************/
+
+bool QMdbToolsTableScan::isInterrupted()
+{
+    if (m_stop && m_stop->loadRelaxed())
+        m_status = Stopped;
+    else if (m_timer && m_timeout > 0 && m_timer->hasExpired(m_timeout))
+        m_status = TimedOut;
+    return m_status != Running;
+}
+
+/************************************************************/
+/// Starts a walk over the usage map of table. The walk ends early when stop is set
+/// or when timer has run for more than timeout msecs.
+QMdbToolsPageWalk::QMdbToolsPageWalk(MdbTableDef *table, const QAtomicInt *stop,
+                                     const QElapsedTimer *timer, int timeout)
+    : m_table(table)
+    , m_stop(stop)
+    , m_timer(timer)
+    , m_timeout(timeout)
+{
+}
+
+/************************************************************/
+/// Moves to the next page in the usage map without reading it.
+/// \return false after the last page or when the walk was interrupted, see status()
+bool QMdbToolsPageWalk::next()
+{
+    if (m_status != Running)
+        return false;
+    if (m_stop && m_stop->loadRelaxed()) {
+        m_status = Stopped;
+        return false;
+    }
+    if (m_timer && m_timeout > 0 && m_timer->hasExpired(m_timeout)) {
+        m_status = TimedOut;
+        return false;
+    }
+    MdbHandle *mdb = m_table->entry->mdb;
+    const gint32 next = mdb_map_find_next(mdb, m_table->usage_map, m_table->map_sz, m_page);
+    if (next <= m_page) {
+        m_status = Finished;
+        return false;
+    }
+    m_page = next;
+    return true;
+}
+
+/************************************************************/
+/// Reads the current page into the page buffer.
+/// \return true if it is a data page of the table; false for other pages and
+/// when the page cannot be read, which ends the walk with ReadError
+bool QMdbToolsPageWalk::read()
+{
+    MdbHandle *mdb = m_table->entry->mdb;
+    if (mdb_read_pg(mdb, m_page) != mdb->fmt->pg_size) {
+        m_status = ReadError;
+        return false;
+    }
+    if (!isTableDataPage(mdb, m_table))
+        return false;
+    m_table->cur_phys_pg = m_page;
+    return true;
+}
+
+/************************************************************/
+/// Moves to and reads the next data page of the table
+bool QMdbToolsPageWalk::nextDataPage()
+{
+    while (next()) {
+        if (read())
+            return true;
+    }
+    return false;
+}
+
+/************************************************************/
+/// Returns true if the page in the page buffer is a data page of table
+bool QMdbToolsPageWalk::isTableDataPage(MdbHandle *mdb, MdbTableDef *table)
+{
+    return mdb->pg_buf[0] == 0x01
+            && mdb_get_int32(mdb->pg_buf, 4) == long(table->entry->table_pg);
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
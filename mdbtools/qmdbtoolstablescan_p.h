@@ -0,0 +1,85 @@
+#ifndef QMDBTOOLSTABLESCAN_P_H
+#define QMDBTOOLSTABLESCAN_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+/// Reads the rows of a table page by page instead of through mdb_fetch_row().
+/// mdb_fetch_row() returns only once it found a matching row, so a selective filter
+/// over a large table could not be interrupted. The scan reads the data pages itself,
+/// checks the stop flag and the time limit before each page and lets mdb_read_row()
+/// test the rows of the page against the sargs of the table.
+/// Index scans and temporary tables are still read with mdb_fetch_row().
+class QMdbToolsTableScan
+{
+public:
+    enum Status { Running, Finished, Stopped, TimedOut };
+
+    explicit QMdbToolsTableScan(MdbTableDef *table, const QAtomicInt *stop = Q_NULLPTR,
+                                const QElapsedTimer *timer = Q_NULLPTR, int timeout = 0);
+
+    bool fetchRow();
+    Status status() const { return m_status; }
+    qint64 rowsScanned() const { return m_rowsScanned; }
+
+private:
+    bool isInterrupted();
+
+    MdbTableDef *m_table;
+    const QAtomicInt *m_stop;
+    const QElapsedTimer *m_timer;
+    int m_timeout;             ///< msecs, 0 is unlimited
+    bool m_byPage;
+    int m_row = 0;             ///< next row slot of the current page
+    int m_rows = 0;            ///< row slots of the current page
+    qint64 m_rowsScanned = 0;  ///< row slots read, rows fetched by mdb_fetch_row()
+    Status m_status = Running;
+};
+
+/// Walks the pages in the usage map of a table without going through libmdb's
+/// row cursor. next() only moves to the next page number, so a caller can decide
+/// to skip a page before it is read; read() loads it into the page buffer.
+class QMdbToolsPageWalk
+{
+public:
+    enum Status { Running, Finished, Stopped, TimedOut, ReadError };
+
+    explicit QMdbToolsPageWalk(MdbTableDef *table, const QAtomicInt *stop = Q_NULLPTR,
+                               const QElapsedTimer *timer = Q_NULLPTR, int timeout = 0);
+
+    bool next();
+    bool read();
+    bool nextDataPage();
+
+    quint32 page() const { return quint32(m_page); }
+    Status status() const { return m_status; }
+
+    static bool isTableDataPage(MdbHandle *mdb, MdbTableDef *table);
+
+private:
+    MdbTableDef *m_table;
+    const QAtomicInt *m_stop;
+    const QElapsedTimer *m_timer;
+    int m_timeout;             ///< msecs, 0 is unlimited
+    gint32 m_page = 0;
+    Status m_status = Running;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSTABLESCAN_P_H
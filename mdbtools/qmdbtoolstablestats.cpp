@@ -0,0 +1,143 @@
+#include "qmdbtoolstablestats_p.h"
+#include "qmdbtoolsfingerprint_p.h"
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolstablescan_p.h"
+
+#include <QHash>
+#include <QSet>
+#include <QtEndian>
+#include <QtMath>
+
+QT_BEGIN_NAMESPACE
+
+/************************************************************/
+
+QMdbToolsTableStatsCollector::QMdbToolsTableStatsCollector(MdbHandle *mdb, MdbTableDef *table)
+    : m_mdb(mdb)
+    , m_table(table)
+{
+}
+
+/************************************************************/
+/// Returns the statistics of the table, sampling at most samplePages data pages
+QMdbToolsTableStats QMdbToolsTableStatsCollector::collect(int samplePages)
+{
+    QMdbToolsTableStats stats;
+    stats.rowCount = m_table->num_rows;
+
+    QVector<quint32> pages;
+    QMdbToolsPageWalk walk(m_table);
+    while (walk.next())
+        pages << walk.page();
+    stats.dataPages = pages.size();
+    stats.indexPages = estimateIndexPages();
+    // one page for the table definition
+    stats.diskBytes = (1 + stats.dataPages + stats.indexPages) * m_mdb->fmt->pg_size;
+    if (stats.rowCount > 0)
+        stats.pageBytesPerRow = double(stats.dataPages * m_mdb->fmt->pg_size) / stats.rowCount;
+
+    if (samplePages > 0 && !pages.isEmpty())
+        sample(pages, samplePages, stats);
+    return stats;
+}
+
+/************************************************************/
+/// Index pages are not in the usage map of the table. Each real index holds an entry
+/// per row, the entry size is estimated from the widths of the key columns.
+qint64 QMdbToolsTableStatsCollector::estimateIndexPages() const
+{
+    mdb_read_indices(m_table);
+
+    // leaf pages start with a header and a bitmap of the entry offsets
+    const int usable = m_mdb->fmt->pg_size - (IS_JET3(m_mdb) ? 0xf8 : 0x1e0);
+    qint64 res = 0;
+    QSet<int> realIndexes;
+    for (uint i = 0; i < m_table->num_idxs; i++) {
+        MdbIndex *idx = static_cast<MdbIndex *>(g_ptr_array_index(m_table->indices, i));
+        if (realIndexes.contains(idx->index_num))
+            continue;
+        realIndexes.insert(idx->index_num);
+
+        // data page and row of the entry
+        qint64 entry = 4;
+        for (int k = 0; k < int(idx->num_keys); ++k) {
+            MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(m_table->columns, idx->key_col_num[k] - 1));
+            entry += 1 + qMin(int(col->col_size), 255);
+        }
+        res += qMax(qint64(1), (m_table->num_rows * entry + usable - 1) / usable);
+    }
+    return res;
+}
+
+/************************************************************/
+/// Reads up to samplePages data pages spread evenly over pages and estimates
+/// the average row size, the null fraction and the distinct values of the columns.
+/// Distinct values are extrapolated with the GEE estimator:
+/// sqrt(rows / sampled rows) * (values seen once) + (values seen more than once).
+void QMdbToolsTableStatsCollector::sample(const QVector<quint32> &pages, int samplePages, QMdbToolsTableStats &stats)
+{
+    const int cols = int(m_table->num_cols);
+    QVector<qint64> nulls(cols, 0);
+    QVector<QHash<quint64, int>> counts(cols);
+    qint64 rowBytes = 0;
+
+    const int n = qMin(samplePages, pages.size());
+    for (int i = 0; i < n; ++i) {
+        const quint32 pg = pages.at(int(qint64(i) * pages.size() / n));
+        if (mdb_read_pg(m_mdb, pg) != m_mdb->fmt->pg_size)
+            break;
+        if (!QMdbToolsPageWalk::isTableDataPage(m_mdb, m_table))
+            continue;
+        m_table->cur_phys_pg = pg;
+        stats.sampledPages++;
+
+        const int rows = qFromLittleEndian<quint16>(m_mdb->pg_buf + m_mdb->fmt->row_count_offset);
+        for (int r = 0; r < rows; ++r) {
+            if (!mdb_read_row(m_table, r))
+                continue;
+            stats.sampledRows++;
+            for (int c = 0; c < cols; ++c) {
+                MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(m_table->columns, c));
+                if (col->col_type == MDB_BOOL) {
+                    counts[c][QMdbToolsPageDecoder::boolValue(col)]++;
+                    continue;
+                }
+                if (col->cur_value_len == 0) {
+                    nulls[c]++;
+                    continue;
+                }
+                rowBytes += col->cur_value_len;
+                counts[c][QMdbToolsTableFingerprint::hash(m_mdb->pg_buf + col->cur_value_start,
+                                                          col->cur_value_len)]++;
+            }
+        }
+    }
+    if (stats.sampledRows == 0)
+        return;
+
+    stats.avgRowBytes = double(rowBytes) / stats.sampledRows;
+    const double scale = qSqrt(qMax(1.0, double(stats.rowCount) / stats.sampledRows));
+    stats.columns.resize(cols);
+    for (int c = 0; c < cols; ++c) {
+        MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(m_table->columns, c));
+        QMdbToolsColumnStats &cs = stats.columns[c];
+        cs.name = QString::fromUtf8(col->name);
+        cs.type = col->col_type;
+        cs.nullFraction = double(nulls.at(c)) / stats.sampledRows;
+
+        qint64 once = 0, more = 0;
+        for (int count : counts.at(c)) {
+            if (count == 1)
+                once++;
+            else
+                more++;
+        }
+        const qint64 estimate = qRound64(scale * once) + more;
+        const qint64 nonNull = qRound64((1.0 - cs.nullFraction) * qMax(stats.rowCount, qint64(stats.sampledRows)));
+        cs.distinctValues = qBound(once + more, estimate, qMax(once + more, nonNull));
+    }
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
@@ -0,0 +1,41 @@
+#ifndef QMDBTOOLSTABLESTATS_P_H
+#define QMDBTOOLSTABLESTATS_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qsql_mdbtools.h"
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+/// Collects QMdbToolsTableStats of a table.
+/// Counts come from the table definition and the usage map without reading data pages;
+/// column estimates come from a sample of data pages spread evenly over the table.
+class QMdbToolsTableStatsCollector
+{
+public:
+    QMdbToolsTableStatsCollector(MdbHandle *mdb, MdbTableDef *table);
+
+    QMdbToolsTableStats collect(int samplePages);
+
+private:
+    qint64 estimateIndexPages() const;
+    void sample(const QVector<quint32> &pages, int samplePages, QMdbToolsTableStats &stats);
+
+    MdbHandle *m_mdb;
+    MdbTableDef *m_table;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSTABLESTATS_P_H
@@ -0,0 +1,227 @@
+#include "qmdbtoolszonemap_p.h"
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolstablescan_p.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QtMath>
+
+QT_BEGIN_NAMESPACE
+
+static const quint32 ZoneMapMagic = 0x4d5a4d51; // "QMZM"
+static const quint32 ZoneMapVersion = 1;
+
+/************************************************************/
+/// Returns true if min/max of col are kept in the zone map
+bool QMdbToolsZoneMap::canSummarize(MdbColumn *col)
+{
+    return QMdbToolsPageDecoder::canDecode(col) && col->col_type != MDB_BOOL;
+}
+
+/************************************************************/
+/// Returns a hash of the usage map of table, it changes whenever pages are added or removed
+quint64 QMdbToolsZoneMap::usageKey(MdbTableDef *table)
+{
+    const QByteArray map = QByteArray::fromRawData(reinterpret_cast<const char *>(table->usage_map),
+                                                   int(table->map_sz));
+    const QByteArray hash = QCryptographicHash::hash(map, QCryptographicHash::Sha1);
+    return qFromLittleEndian<quint64>(hash.constData());
+}
+
+/************************************************************/
+/// Reads all data pages of table and summarizes them.
+/// Fails if stop is set or timer runs for more than timeout msecs before the last page.
+bool QMdbToolsZoneMap::build(MdbHandle *mdb, MdbTableDef *table, const QAtomicInt *stop,
+                             const QElapsedTimer *timer, int timeout)
+{
+    QList<MdbColumn*> cols;
+    m_colNums.clear();
+    for (uint i = 0; i < table->num_cols; i++) {
+        MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(table->columns, i));
+        if (canSummarize(col)) {
+            cols << col;
+            m_colNums << col->col_num;
+        }
+    }
+    m_pages.clear();
+    m_rowCounts.clear();
+    m_mins = QVector<QVector<double>>(cols.size());
+    m_maxs = QVector<QVector<double>>(cols.size());
+    m_nulls = QVector<QVector<quint32>>(cols.size());
+
+    QMdbToolsPageDecoder decoder(mdb, cols);
+    QMdbToolsPageWalk walk(table, stop, timer, timeout);
+    while (walk.nextDataPage()) {
+        const int rows = decoder.decodePage(mdb->pg_buf);
+        m_pages << walk.page();
+        m_rowCounts << quint32(rows);
+        const auto &batches = decoder.columns();
+        for (int c = 0; c < batches.size(); ++c) {
+            const QMdbToolsColumnBatch &batch = batches.at(c);
+            double min = qInf();
+            double max = -qInf();
+            quint32 nulls = 0;
+            for (int r = 0; r < rows; ++r) {
+                if (batch.isNull(r)) {
+                    nulls++;
+                    continue;
+                }
+                const double value = batch.isInteger() ? batch.ints.at(r) : batch.reals.at(r);
+                min = qMin(min, value);
+                max = qMax(max, value);
+            }
+            m_mins[c] << min;
+            m_maxs[c] << max;
+            m_nulls[c] << nulls;
+        }
+    }
+    if (walk.status() != QMdbToolsPageWalk::Finished)
+        return false;
+
+    m_pageIndex.clear();
+    for (int p = 0; p < m_pages.size(); ++p)
+        m_pageIndex.insert(m_pages.at(p), p);
+    m_colIndex.clear();
+    for (int c = 0; c < m_colNums.size(); ++c)
+        m_colIndex.insert(m_colNums.at(c), c);
+    return true;
+}
+
+/************************************************************/
+/// Loads a zone map saved for the same database file and usage map
+bool QMdbToolsZoneMap::load(const QString &fileName, const QMdbToolsFileKey &key, quint64 usageKey)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0, version = 0;
+    qint64 size = 0, mtime = 0;
+    quint64 checksum = 0, usage = 0;
+    in >> magic >> version >> size >> mtime >> checksum >> usage;
+    if (magic != ZoneMapMagic || version != ZoneMapVersion)
+        return false;
+    if (size != key.size || mtime != key.mtime || checksum != key.checksum || usage != usageKey)
+        return false;
+
+    in >> m_colNums >> m_pages >> m_rowCounts >> m_mins >> m_maxs >> m_nulls;
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    m_pageIndex.clear();
+    for (int p = 0; p < m_pages.size(); ++p)
+        m_pageIndex.insert(m_pages.at(p), p);
+    m_colIndex.clear();
+    for (int c = 0; c < m_colNums.size(); ++c)
+        m_colIndex.insert(m_colNums.at(c), c);
+    return true;
+}
+
+/************************************************************/
+
+bool QMdbToolsZoneMap::save(const QString &fileName, const QMdbToolsFileKey &key, quint64 usageKey) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out << ZoneMapMagic << ZoneMapVersion
+        << key.size << key.mtime << key.checksum << usageKey
+        << m_colNums << m_pages << m_rowCounts << m_mins << m_maxs << m_nulls;
+    if (out.status() != QDataStream::Ok)
+        return false;
+    return file.commit();
+}
+
+/************************************************************/
+/// Returns false if no row of page can satisfy the condition node.
+/// Pages not in the zone map and conditions on other columns may always match.
+bool QMdbToolsZoneMap::mayMatch(quint32 page, MdbSargNode *node) const
+{
+    auto it = m_pageIndex.constFind(page);
+    if (!node || it == m_pageIndex.constEnd())
+        return true;
+    return mayMatch(it.value(), node);
+}
+
+/************************************************************/
+
+bool QMdbToolsZoneMap::mayMatch(int p, MdbSargNode *node) const
+{
+    switch (node->op) {
+    case MDB_AND:
+        return (!node->left || mayMatch(p, node->left))
+                && (!node->right || mayMatch(p, node->right));
+    case MDB_OR:
+        return !node->left || !node->right
+                || mayMatch(p, node->left) || mayMatch(p, node->right);
+    case MDB_NOT:
+        return true;
+    default:
+        break;
+    }
+
+    if (!node->col)
+        return true;
+    auto it = m_colIndex.constFind(node->col->col_num);
+    if (it == m_colIndex.constEnd())
+        return true;
+    const int c = it.value();
+    const quint32 nulls = m_nulls.at(c).at(p);
+    const quint32 rows  = m_rowCounts.at(p);
+
+    switch (node->op) {
+    case MDB_ISNULL:
+        return nulls > 0;
+    case MDB_NOTNULL:
+        return nulls < rows;
+    default:
+        break;
+    }
+
+    double value = 0;
+    switch (node->val_type) {
+    case MDB_INT:
+    case MDB_LONGINT:
+        value = node->value.i;
+        break;
+    case MDB_FLOAT:
+    case MDB_DOUBLE:
+    case MDB_DATETIME:
+        value = node->value.d;
+        break;
+    default:
+        return true;
+    }
+
+    // nulls never satisfy a comparison
+    if (nulls >= rows)
+        return false;
+    const double min = m_mins.at(c).at(p);
+    const double max = m_maxs.at(c).at(p);
+    switch (node->op) {
+    case MDB_EQUAL:
+        return value >= min && value <= max;
+    case MDB_GT:
+        return max > value;
+    case MDB_GTEQ:
+        return max >= value;
+    case MDB_LT:
+        return min < value;
+    case MDB_LTEQ:
+        return min <= value;
+    case MDB_NEQ:
+        return !(min == max && min == value);
+    default:
+        break;
+    }
+    return true;
+}
+
+/************************************************************/
+
+QT_END_NAMESPACE
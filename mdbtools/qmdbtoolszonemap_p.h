@@ -0,0 +1,57 @@
+#ifndef QMDBTOOLSZONEMAP_P_H
+#define QMDBTOOLSZONEMAP_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of the QMdbTools driver.  This header file may change from version
+// to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmdbtoolssnapshot_p.h"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+
+#include <mdbtools.h>
+
+QT_BEGIN_NAMESPACE
+
+/// Per data page min/max and null count of the fixed-width numeric columns of a table.
+/// Filtered scans use it to skip the pages whose values cannot match the WHERE clause.
+class QMdbToolsZoneMap
+{
+public:
+    static bool canSummarize(MdbColumn *col);
+    static quint64 usageKey(MdbTableDef *table);
+
+    bool build(MdbHandle *mdb, MdbTableDef *table, const QAtomicInt *stop = Q_NULLPTR,
+               const QElapsedTimer *timer = Q_NULLPTR, int timeout = 0);
+    bool load(const QString &fileName, const QMdbToolsFileKey &key, quint64 usageKey);
+    bool save(const QString &fileName, const QMdbToolsFileKey &key, quint64 usageKey) const;
+
+    int pageCount() const { return m_pages.size(); }
+    bool mayMatch(quint32 page, MdbSargNode *node) const;
+
+private:
+    bool mayMatch(int pageIdx, MdbSargNode *node) const;
+
+    QVector<qint32> m_colNums;           ///< col_num of the summarized columns
+    QVector<quint32> m_pages;            ///< data page numbers
+    QVector<quint32> m_rowCounts;        ///< live rows per page
+    QVector<QVector<double>> m_mins;     ///< [column][page] smallest non-null value
+    QVector<QVector<double>> m_maxs;     ///< [column][page] largest non-null value
+    QVector<QVector<quint32>> m_nulls;   ///< [column][page] null count
+    QHash<quint32, int> m_pageIndex;
+    QHash<qint32, int> m_colIndex;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMDBTOOLSZONEMAP_P_H
@@ -1,7 +1,28 @@
 #include "qsql_mdbtools.h"
+#include "qmdbtoolsexport_p.h"
+#include "qmdbtoolsfingerprint_p.h"
+#include "qmdbtoolstablestats_p.h"
+#include "qmdbtoolsrowstore_p.h"
+#include "qmdbtoolsresultcache_p.h"
+#include "qmdbtoolspagedecoder_p.h"
+#include "qmdbtoolssnapshot_p.h"
+#include "qmdbtoolstablescan_p.h"
+#include "qmdbtoolszonemap_p.h"
 
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QLoggingCategory>
+#include <QtEndian>
+#include <QHash>
+#include <QSharedPointer>
+#include <QDataStream>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QDir>
+#include <QFileInfo>
 
 #include <QSqlError>
 #include <QSqlResult>
@@ -29,6 +50,8 @@ Q_DECLARE_METATYPE(MdbSQL*)
 
 QT_BEGIN_NAMESPACE
 
+Q_LOGGING_CATEGORY(lcMdbTools, "qt.sql.mdbtools")
+
 /************************************************************/
 /*
 static QString _q_escapeIdentifier(const QString &identifier)
@@ -92,63 +115,283 @@ static QSqlField qMakeField(MdbColumn *col)
 }
 
 /************************************************************/
+/// Jet4 TEXT and inline MEMO values are decoded by the driver directly from the page,
+/// so libmdb does not need to convert them into the bound buffers.
+static bool qIsDirectText(MdbHandle *mdb, MdbColumn *col)
+{
+    return !IS_JET3(mdb) && (col->col_type == MDB_TEXT || col->col_type == MDB_MEMO);
+}
 
-static QVariant qGetValue(MdbSQL *sql, MdbColumn *col, uint colNum) {
-    if (!col) {
-        return QString::fromUtf8(static_cast<char *>(sql->bound_values[colNum]));;
+/************************************************************/
+
+static QVariant qDateTimeValue(double value, bool shortDate)
+{
+    struct tm tmp_t = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    mdb_date_to_tm(value, &tmp_t);
+    QDate date(tmp_t.tm_year + 1900, tmp_t.tm_mon + 1, tmp_t.tm_mday);
+    if (shortDate) {
+        return date;
     }
-    // bool cannot be null
+    QTime time(tmp_t.tm_hour, tmp_t.tm_min, tmp_t.tm_sec);
+    return QDateTime(date, time);
+}
+
+/************************************************************/
+/// Converts a value of a decoded page column like qGetValue() does
+static QVariant qGetColumnStoreValue(const QMdbToolsColumnStore &store, int column, int row)
+{
+    switch (store.columnType(column)) {
+    case MDB_BOOL:
+        return bool(store.intValue(column, row));
+    case MDB_FLOAT:
+        if (store.isNull(column, row))
+            return QVariant();
+        return float(store.realValue(column, row));
+    case MDB_DOUBLE:
+        if (store.isNull(column, row))
+            return QVariant();
+        return store.realValue(column, row);
+    case MDB_DATETIME:
+        if (store.isNull(column, row))
+            return QVariant();
+        return qDateTimeValue(store.realValue(column, row), store.isShortDate(column));
+    default:
+        break;
+    }
+    if (store.isNull(column, row))
+        return QVariant();
+    return store.intValue(column, row);
+}
+
+/************************************************************/
+/// Converts a value of a snapshot column like qGetValue() does
+static QVariant qGetSnapshotValue(const QMdbToolsSnapshot &snapshot, int column, qint64 row, bool shortDate)
+{
+    const int type = snapshot.columnType(column);
+    if (type == MDB_BOOL)
+        return bool(snapshot.intValue(column, row));
+    if (snapshot.isNull(column, row))
+        return QVariant();
+    switch (type) {
+    case MDB_FLOAT:
+        return float(snapshot.realValue(column, row));
+    case MDB_DOUBLE:
+        return snapshot.realValue(column, row);
+    case MDB_DATETIME:
+        return qDateTimeValue(snapshot.realValue(column, row), shortDate);
+    case MDB_TEXT:
+        return snapshot.textValue(column, row);
+    default:
+        break;
+    }
+    return snapshot.intValue(column, row);
+}
+
+/************************************************************/
+/// Converts the value of col in the current row. Values libmdb converts to text are read
+/// from the bound buffer of col, Jet4 text is decoded from the page.
+static QVariant qGetColumnValue(MdbHandle *mdb, MdbColumn *col, QMdbToolsQueryStats *stats) {
     if (col->col_type == MDB_BOOL) {
-        return (col->cur_value_len ? false : true);
+        return QMdbToolsPageDecoder::boolValue(col);
     }
     // null value
     if (col->cur_value_len == 0) {
         return QVariant();
     }
     // not null value
+    stats->bytesDecoded += col->cur_value_len;
     switch (col->col_type) {
     case MDB_BYTE:
-        return mdb_get_byte(sql->mdb->pg_buf, col->cur_value_start);
+        return mdb_get_byte(mdb->pg_buf, col->cur_value_start);
     case MDB_INT:
-        return mdb_get_int16(sql->mdb->pg_buf, col->cur_value_start);
+        return mdb_get_int16(mdb->pg_buf, col->cur_value_start);
     case MDB_LONGINT:
-        return (qint32)mdb_get_int32(sql->mdb->pg_buf, col->cur_value_start);
+        return (qint32)mdb_get_int32(mdb->pg_buf, col->cur_value_start);
     case MDB_FLOAT:
-        return mdb_get_single(sql->mdb->pg_buf, col->cur_value_start);
+        return mdb_get_single(mdb->pg_buf, col->cur_value_start);
     case MDB_DOUBLE:
-        return mdb_get_double(sql->mdb->pg_buf, col->cur_value_start);
+        return mdb_get_double(mdb->pg_buf, col->cur_value_start);
     case MDB_DATETIME:
-        {
-            struct tm tmp_t = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-            mdb_date_to_tm(mdb_get_double(sql->mdb->pg_buf, col->cur_value_start), &tmp_t);
-            const char *format = mdb_col_get_prop(col, "Format");
-            if (format && !strcmp(format, "Short Date")) {
-                return QDate(tmp_t.tm_year + 1900, tmp_t.tm_mon + 1, tmp_t.tm_mday);
-            } else {
-                QDate date(tmp_t.tm_year + 1900, tmp_t.tm_mon + 1, tmp_t.tm_mday);
-                QTime time(tmp_t.tm_hour, tmp_t.tm_min, tmp_t.tm_sec);
-                return QDateTime(date, time);
-            }
-        }
-        break;
+        return qDateTimeValue(mdb_get_double(mdb->pg_buf, col->cur_value_start), QMdbToolsPageDecoder::isShortDate(col));
     case MDB_OLE:
         if (mdb_get_int32(col->bind_ptr, 0)) {
             size_t size = 0;
-            auto val = mdb_ole_read_full(sql->mdb, col, &size);
+            auto val = mdb_ole_read_full(mdb, col, &size);
+            stats->oleBytesRead += size;
             auto rawData = QByteArray::fromRawData(static_cast<char *>(val), size);
             auto result = QString::fromUtf8(rawData);
             g_free(val);
             return result;
         }
         break;
+    case MDB_TEXT:
+    case MDB_MEMO:
+        if (qIsDirectText(mdb, col))
+            return QMdbToolsPageDecoder::columnText(mdb, col);
+        return QString::fromUtf8(static_cast<char *>(col->bind_ptr));
     default:
-        return QString::fromUtf8(static_cast<char *>(sql->bound_values[colNum]));
+        return QString::fromUtf8(static_cast<char *>(col->bind_ptr));
     }
     return QVariant();
 }
 
 /************************************************************/
 
+static QVariant qGetValue(MdbSQL *sql, MdbColumn *col, uint colNum, QMdbToolsQueryStats *stats) {
+    if (!col) {
+        return QString::fromUtf8(static_cast<char *>(sql->bound_values[colNum]));;
+    }
+    return qGetColumnValue(sql->mdb, col, stats);
+}
+
+/************************************************************/
+/// Matches the result columns of the query in sql with the columns of its table
+/// and appends a field per result column to rec.
+static QList<MdbColumn*> qBindColumns(MdbSQL *sql, QSqlRecord *rec)
+{
+    QList<MdbColumn*> cols;
+    auto table = sql->cur_table;
+    for (uint i = 0; i < sql->num_columns; i++) {
+         MdbSQLColumn *sqlCol = static_cast<MdbSQLColumn *>(g_ptr_array_index(sql->columns, i));
+         MdbColumn *col = Q_NULLPTR;
+         for (uint j=0; j < table->num_cols; ++j) {
+             MdbColumn *tblCol = static_cast<MdbColumn*>(g_ptr_array_index(table->columns, j));
+             if (!g_ascii_strcasecmp(sqlCol->name, tblCol->name)) {
+                 col = tblCol;
+                 break;
+             }
+         }
+         cols << col;
+         if (col && qIsDirectText(sql->mdb, col)) {
+             // decoded by QMdbToolsPageDecoder::columnText(), skip the UTF-8 conversion in libmdb
+             col->bind_ptr = Q_NULLPTR;
+             col->len_ptr  = Q_NULLPTR;
+         }
+         if (col) {
+             auto fld = qMakeField(col);
+             rec->append(fld);
+         } else {
+             QString colName   = QString::fromUtf8(sqlCol->name);
+             QString tableName = QString::fromUtf8(table->name);
+             QSqlField fld(colName, QVariant::String, tableName);
+             fld.setSqlType(MDB_TEXT);
+             fld.setReadOnly(true);
+             rec->append(fld);
+         }
+    }
+    return cols;
+}
+
+/************************************************************/
+/// The SQL parser of libmdb keeps its state in globals, queries are parsed one at a time
+Q_GLOBAL_STATIC(QMutex, qSqlParserMutex)
+
+static void qRunQuery(MdbSQL *sql, const QString &query)
+{
+    QMutexLocker locker(qSqlParserMutex());
+    mdb_sql_run_query(sql, const_cast<char *>(qUtf8Printable(query)));
+}
+
+/************************************************************/
+/// Rows of a query run on one file of a sharded connection
+struct QMdbToolsShardResult
+{
+    QString file;
+    QSqlRecord record;
+    QSharedPointer<QMdbToolsRowStore> rows;
+    QString error;
+    QMdbToolsQueryStats stats;
+};
+
+/************************************************************/
+/// Row and size limits of a result, shared by all shard tasks of the query
+struct QMdbToolsShardBudget
+{
+    int maxRows = 0;               ///< 0 is unlimited
+    qint64 maxBytes = 0;           ///< 0 is unlimited
+    QAtomicInt rows;
+    QAtomicInteger<qint64> bytes;
+    QAtomicInt exceeded;           ///< error code of the first limit exceeded
+
+    /// Accounts a row of size bytes. \return false if a limit is exceeded
+    bool add(qint64 size) {
+        if (maxRows > 0 && rows.fetchAndAddRelaxed(1) >= maxRows) {
+            exceeded.testAndSetRelaxed(0, -14);
+            return false;
+        }
+        if (maxBytes > 0 && bytes.fetchAndAddRelaxed(size) + size > maxBytes) {
+            exceeded.testAndSetRelaxed(0, -15);
+            return false;
+        }
+        return true;
+    }
+};
+
+/************************************************************/
+/// Runs a query on one shard file with its own libmdb handle.
+/// A task exceeding the shared budget sets stop, which ends all tasks of the query.
+class QMdbToolsShardTask : public QRunnable
+{
+public:
+    QMdbToolsShardTask(const QString &query, QAtomicInt *stop, QMdbToolsShardBudget *budget,
+                       QMdbToolsShardResult *result)
+        : m_query(query), m_stop(stop), m_budget(budget), m_result(result)
+    {
+    }
+
+    void run() override;
+
+private:
+    QString m_query;
+    QAtomicInt *m_stop;
+    QMdbToolsShardBudget *m_budget;
+    QMdbToolsShardResult *m_result;
+};
+
+/************************************************************/
+
+void QMdbToolsShardTask::run()
+{
+    MdbSQL *sql = mdb_sql_init();
+    mdb_sql_open(sql, const_cast<char *>(qPrintable(m_result->file)));
+    if (mdb_sql_has_error(sql) || !sql->mdb || !mdb_read_catalog(sql->mdb, MDB_ANY)) {
+        m_result->error = QString::fromLocal8Bit(sql->error_msg);
+        mdb_sql_exit(sql);
+        return;
+    }
+    mdb_stats_on(sql->mdb);
+
+    qRunQuery(sql, m_query);
+    if (mdb_sql_has_error(sql)) {
+        m_result->error = QString::fromLocal8Bit(sql->error_msg);
+    } else {
+        const QList<MdbColumn*> cols = qBindColumns(sql, &m_result->record);
+        QMdbToolsTableScan scan(sql->cur_table, m_stop);
+        while (scan.fetchRow()) {
+            QVariantList values;
+            values.reserve(cols.size() + 1);
+            for (uint i = 0; i < sql->num_columns; ++i)
+                values << qGetValue(sql, cols.at(i), i, &m_result->stats);
+            values << m_result->file;
+            if (!m_budget->add(QMdbToolsRowStore::rowSize(values))) {
+                m_stop->storeRelaxed(1);
+                break;
+            }
+            m_result->rows->append(values);
+        }
+        m_result->stats.rowsScanned = scan.rowsScanned();
+        if (scan.status() == QMdbToolsTableScan::Stopped)
+            m_result->error = QString::fromUtf8("Query stopped");
+    }
+    m_result->stats.pagesRead = sql->mdb->stats ? sql->mdb->stats->pg_reads : 0;
+
+    mdb_sql_reset(sql);
+    mdb_sql_close(sql);
+    mdb_sql_exit(sql);
+}
+
+/************************************************************/
+
 class QMdbToolsDriverPrivate : public QSqlDriverPrivate
 {
     Q_DECLARE_PUBLIC(QMdbToolsDriver)
@@ -162,6 +405,9 @@ public:
 
     ~QMdbToolsDriverPrivate()
     {
+        stopSnapshotBuilds();
+        delete snapshotPool;
+        delete shardPool;
         mdb_sql_exit(access);
     }
 
@@ -186,9 +432,196 @@ public:
         return QString::fromLocal8Bit(access->error_msg);
     }
 
+    qint64 pagesRead() const {
+        return (access->mdb && access->mdb->stats) ? access->mdb->stats->pg_reads : 0;
+    }
+
+    void setOptions(const QString &connOpts) {
+        queryTimeout   = 0;
+        maxRows        = 0;
+        maxResultBytes = 0;
+        resultMemory   = 0;
+        slowQueryTime  = -1;
+        snapshots      = false;
+        zoneMaps       = false;
+        resultCache    = false;
+        snapshotDir.clear();
+        const auto opts = connOpts.split(QLatin1Char(';'), Qt::SkipEmptyParts);
+        for (const auto &option : opts) {
+            const QString opt = option.trimmed();
+            const int eq = opt.indexOf(QLatin1Char('='));
+            if (eq < 0) {
+                qWarning() << "QMdbToolsDriver::open: Unknown connect option" << opt;
+                continue;
+            }
+            const QString name  = opt.left(eq).trimmed();
+            const QString value = opt.mid(eq + 1).trimmed();
+            bool ok = false;
+            if (name == QLatin1String("QMDBTOOLS_QUERY_TIMEOUT")) {
+                queryTimeout = value.toInt(&ok);
+            } else if (name == QLatin1String("QMDBTOOLS_MAX_ROWS")) {
+                maxRows = value.toInt(&ok);
+            } else if (name == QLatin1String("QMDBTOOLS_MAX_RESULT_BYTES")) {
+                maxResultBytes = value.toLongLong(&ok);
+            } else if (name == QLatin1String("QMDBTOOLS_RESULT_MEMORY_BYTES")) {
+                resultMemory = value.toLongLong(&ok);
+            } else if (name == QLatin1String("QMDBTOOLS_SLOW_QUERY_MS")) {
+                slowQueryTime = value.toInt(&ok);
+            } else if (name == QLatin1String("QMDBTOOLS_SNAPSHOTS")) {
+                snapshots = value.toInt(&ok) != 0;
+            } else if (name == QLatin1String("QMDBTOOLS_RESULT_CACHE_BYTES")) {
+                const qint64 bytes = value.toLongLong(&ok);
+                resultCache = bytes > 0;
+                if (ok && resultCache)
+                    QMdbToolsResultCache::instance()->setBudget(bytes);
+            } else if (name == QLatin1String("QMDBTOOLS_ZONE_MAPS")) {
+                zoneMaps = value.toInt(&ok) != 0;
+            } else if (name == QLatin1String("QMDBTOOLS_SNAPSHOT_DIR")) {
+                snapshots = true;
+                snapshotDir = value;
+                ok = true;
+            } else {
+                qWarning() << "QMdbToolsDriver::open: Unknown connect option" << name;
+                continue;
+            }
+            if (!ok) {
+                qWarning() << "QMdbToolsDriver::open: Illegal value for connect option" << name << value;
+            }
+        }
+    }
+
+    static QStringList expandShards(const QString &db);
+
+    /// Cancels the snapshot conversions running in the background and waits for them
+    void stopSnapshotBuilds() {
+        if (!snapshotPool)
+            return;
+        snapshotStop.storeRelaxed(1);
+        snapshotPool->waitForDone();
+        snapshotStop.storeRelaxed(0);
+        snapshotBuilds.clear();
+    }
+
     MdbSQL *access = Q_NULLPTR;
+    QThreadPool *shardPool = Q_NULLPTR;
+    QThreadPool *snapshotPool = Q_NULLPTR;  ///< converts one table at a time
+    int queryTimeout = 0;       ///< max wall time of a query in msecs, 0 is unlimited
+    int maxRows = 0;            ///< max number of rows in a result, 0 is unlimited
+    qint64 maxResultBytes = 0;  ///< max materialized size of a result, 0 is unlimited
+    qint64 resultMemory = 0;    ///< rows beyond this size are spilled to disk, 0 is unlimited
+    int slowQueryTime = -1;     ///< queries running longer (msecs) are logged as slow, -1 disables
+    bool snapshots = false;     ///< scans are served from columnar snapshot files
+    bool zoneMaps = false;      ///< filtered scans skip pages using zone maps
+    bool resultCache = false;   ///< results are shared through the process wide result cache
+    QString snapshotDir;        ///< directory of the snapshot and zone map files, empty is next to the database
+    QString fileName;
+    QStringList shards;         ///< files of a sharded connection, the first one is opened
+    QMdbToolsFileKey fileKey;
+    mutable QHash<QString, QSharedPointer<QMdbToolsSnapshot>> snapshotCache;
+    mutable QHash<QString, QSharedPointer<QMdbToolsSnapshotTask::State>> snapshotBuilds;
+    QAtomicInt snapshotStop;
+    mutable QHash<QString, QSharedPointer<QMdbToolsZoneMap>> zoneMapCache;
+    mutable QAtomicInt cancelRequested;
+    mutable QMdbToolsQueryStats lastStats;
+
+    QSharedPointer<QMdbToolsSnapshot> snapshot(const QString &table) const;
+    QSharedPointer<QMdbToolsZoneMap> zoneMap(MdbTableDef *table, const QElapsedTimer *timer) const;
 };
 
+/************************************************************/
+/// Splits the database name of a sharded connection into files.
+/// The name is a ';' separated list of files, each entry may be a wildcard pattern.
+/// An entry naming an existing file is never expanded, e.g. "x [2019].mdb".
+QStringList QMdbToolsDriverPrivate::expandShards(const QString &db)
+{
+    QStringList res;
+    const auto entries = db.split(QLatin1Char(';'), Qt::SkipEmptyParts);
+    for (const auto &entry : entries) {
+        const QString name = entry.trimmed();
+        const bool isPattern = name.contains(QLatin1Char('*')) || name.contains(QLatin1Char('?'))
+                || name.contains(QLatin1Char('['));
+        if (!isPattern || QFileInfo::exists(name)) {
+            res << name;
+            continue;
+        }
+        const QFileInfo info(name);
+        QDir dir = info.dir();
+        const auto files = dir.entryList(QStringList(info.fileName()), QDir::Files, QDir::Name);
+        for (const auto &file : files)
+            res << dir.filePath(file);
+    }
+    return res;
+}
+
+/************************************************************/
+/// Returns the snapshot of table. A missing or stale snapshot is converted in the background,
+/// queries read the table itself until the conversion has finished.
+QSharedPointer<QMdbToolsSnapshot> QMdbToolsDriverPrivate::snapshot(const QString &table) const
+{
+    auto it = snapshotCache.constFind(table);
+    if (it != snapshotCache.constEnd())
+        return it.value();
+
+    QSharedPointer<QMdbToolsSnapshot> res(new QMdbToolsSnapshot);
+    const QString file = QMdbToolsSnapshot::fileName(snapshotDir, fileName, table);
+    auto build = snapshotBuilds.value(table);
+    if (!build) {
+        if (res->open(file, fileKey)) {
+            snapshotCache.insert(table, res);
+            return res;
+        }
+        build.reset(new QMdbToolsSnapshotTask::State);
+        snapshotBuilds.insert(table, build);
+        snapshotPool->start(new QMdbToolsSnapshotTask(fileName, table, fileKey, file, &snapshotStop, build));
+        return QSharedPointer<QMdbToolsSnapshot>();
+    }
+    if (!build->done.loadAcquire())
+        return QSharedPointer<QMdbToolsSnapshot>();
+
+    snapshotBuilds.remove(table);
+    if (!build->ok) {
+        qCWarning(lcMdbTools) << "Cannot create snapshot" << file << build->error;
+        res.reset();
+    } else if (!res->open(file, fileKey)) {
+        qCWarning(lcMdbTools) << "Cannot open snapshot" << file;
+        res.reset();
+    } else {
+        qCDebug(lcMdbTools) << "Created snapshot" << file;
+    }
+    snapshotCache.insert(table, res);
+    return res;
+}
+
+/************************************************************/
+/// Returns the zone map of table, loading or building it on first access.
+/// The build stops on cancelQuery() and at the query timeout counted by timer;
+/// the map is then built again by the next query.
+QSharedPointer<QMdbToolsZoneMap> QMdbToolsDriverPrivate::zoneMap(MdbTableDef *table, const QElapsedTimer *timer) const
+{
+    const QString name = QString::fromUtf8(table->name);
+    auto it = zoneMapCache.constFind(name);
+    if (it != zoneMapCache.constEnd())
+        return it.value();
+
+    const quint64 usageKey = QMdbToolsZoneMap::usageKey(table);
+    QSharedPointer<QMdbToolsZoneMap> res(new QMdbToolsZoneMap);
+    const QString file = QMdbToolsSnapshot::fileName(snapshotDir, fileName, name, QLatin1String("qmdbzone"));
+    if (!res->load(file, fileKey, usageKey)) {
+        if (!res->build(access->mdb, table, &cancelRequested, timer, queryTimeout)) {
+            res.reset();
+            if (cancelRequested.loadRelaxed() || (queryTimeout > 0 && timer->hasExpired(queryTimeout)))
+                return res;
+            qCWarning(lcMdbTools) << "Cannot build zone map of" << name;
+        } else if (!res->save(file, fileKey, usageKey)) {
+            qCWarning(lcMdbTools) << "Cannot save zone map" << file;
+        } else {
+            qCDebug(lcMdbTools) << "Created zone map" << file << res->pageCount() << "pages";
+        }
+    }
+    zoneMapCache.insert(name, res);
+    return res;
+}
+
 /************************************************************/
 
 class QMdbToolsResultPrivate;
@@ -225,12 +658,17 @@ public:
     Q_DECLARE_SQLDRIVER_PRIVATE(QMdbToolsDriver)
     QMdbToolsResultPrivate(QMdbToolsResult *q, const QMdbToolsDriver *db)
         : QSqlResultPrivate(q, db)
+        , data(new QMdbToolsRowStore)
     {
 
     }
 
     inline void clearData() {
-        data.clear();
+        data.reset(new QMdbToolsRowStore);
+        columns.reset();
+        snapshot.reset();
+        snapshotColumns.clear();
+        snapshotShortDate.clear();
     }
 
     inline void clearInfo() {
@@ -246,19 +684,457 @@ public:
         return access() ? access()->mdb : Q_NULLPTR;
     }
 
+    int rowCount() const {
+        if (snapshot)
+            return int(snapshot->rowCount());
+        return columns ? columns->size() : data->size();
+    }
+
+    /// Returns the value of column in row from the store that holds the result
+    QVariant value(int row, int column) const {
+        if (snapshot)
+            return qGetSnapshotValue(*snapshot, snapshotColumns.at(column), row, snapshotShortDate.at(column));
+        if (columns)
+            return qGetColumnStoreValue(*columns, column, row);
+        return data->value(row, column);
+    }
+
+    bool isNullValue(int row, int column) const {
+        if (snapshot) {
+            const int c = snapshotColumns.at(column);
+            return snapshot->columnType(c) != MDB_BOOL && snapshot->isNull(c, row);
+        }
+        if (columns)
+            return columns->isNull(column, row);
+        return data->row(row).value(column).isNull();
+    }
+
     bool isRowValid(int idx) const {
-        return (idx > QSql::BeforeFirstRow && idx < data.size());
+        return (idx > QSql::BeforeFirstRow && idx < rowCount());
     }
 
     bool isFieldIdxInRange(int idx) const {
         return (idx >= 0 && idx < recInf.count());
     }
 
+    bool isCancelRequested() const {
+        return drv_d_func() && drv_d_func()->cancelRequested.loadRelaxed();
+    }
+
+    /// Checks cancellation and the time limit, also between pages without matching rows
+    bool checkInterrupted() {
+        const int timeout = drv_d_func()->queryTimeout;
+        if (isCancelRequested()) {
+            return abort(qMakeError(QString(), QString::fromUtf8("Query cancelled"),
+                                    QSqlError::StatementError, -12));
+        }
+        if (timeout > 0 && timer.hasExpired(timeout)) {
+            return abort(qMakeError(QString::fromUtf8("Query exceeded %1 ms").arg(timeout),
+                                    QString::fromUtf8("Query timeout"),
+                                    QSqlError::StatementError, -13));
+        }
+        return true;
+    }
+
+    /// Checks cancellation, the time limit and the row limit before a row is added
+    bool canAddRow() {
+        const int maxRows = drv_d_func()->maxRows;
+        if (!checkInterrupted())
+            return false;
+        if (maxRows > 0 && rowCount() >= maxRows)
+            return abort(rowLimitError());
+        return true;
+    }
+
+    QSqlError rowLimitError() const {
+        return qMakeError(QString::fromUtf8("Query returned more than %1 rows").arg(drv_d_func()->maxRows),
+                          QString::fromUtf8("Row limit exceeded"),
+                          QSqlError::StatementError, -14);
+    }
+
+    QSqlError memoryLimitError() const {
+        return qMakeError(QString::fromUtf8("Query result exceeded %1 bytes").arg(drv_d_func()->maxResultBytes),
+                          QString::fromUtf8("Memory limit exceeded"),
+                          QSqlError::StatementError, -15);
+    }
+
+    /// Adds a row to the result and checks the memory limit
+    bool addRow(const QVariantList &values) {
+        const qint64 maxBytes = drv_d_func()->maxResultBytes;
+        resultBytes += QMdbToolsRowStore::rowSize(values);
+        data->append(values);
+        stats.rowsReturned++;
+        if (maxBytes > 0 && resultBytes > maxBytes)
+            return abort(memoryLimitError());
+        return true;
+    }
+
+    /// Adds the rows of a decoded page to the result and checks the row and memory limits
+    bool addBatch(const QVector<QMdbToolsColumnBatch> &batches, int rows) {
+        const int maxRows = drv_d_func()->maxRows;
+        const qint64 maxBytes = drv_d_func()->maxResultBytes;
+        if (maxRows > 0 && columns->size() + rows > maxRows)
+            return abort(rowLimitError());
+        columns->append(batches, rows);
+        stats.rowsReturned += rows;
+        resultBytes = columns->byteSize();
+        if (maxBytes > 0 && resultBytes > maxBytes)
+            return abort(memoryLimitError());
+        return true;
+    }
+
+    bool fetchCached(const QString &key);
+    bool fanOut(const QString &query);
+    bool isPlainScan(MdbSQL *sql) const;
+    bool canScanPages(MdbSQL *sql) const;
+    bool scanPages(qint64 &mark);
+    QSharedPointer<QMdbToolsSnapshot> snapshotFor(MdbSQL *sql) const;
+    bool scanSnapshot(const QSharedPointer<QMdbToolsSnapshot> &source, qint64 &mark);
+    QSharedPointer<QMdbToolsZoneMap> zoneMapFor(MdbSQL *sql) const;
+    bool scanZones(const QMdbToolsZoneMap &zoneMap, qint64 &mark);
+
+    /// Drops a partially fetched result and reports why the scan was stopped
+    bool abort(const QSqlError &error) {
+        Q_Q(QMdbToolsResult);
+        clearData();
+        clearInfo();
+        mdb_sql_reset(access());
+        q->setLastError(error);
+        finishStats();
+        return false;
+    }
+
+    /// Publishes the counters of the finished query and logs them
+    void finishStats() {
+        Q_Q(QMdbToolsResult);
+        stats.pagesRead = drv_d_func()->pagesRead() - pagesAtStart + shardPagesRead;
+        drv_d_func()->lastStats = stats;
+        const int slowQueryTime = drv_d_func()->slowQueryTime;
+        if (slowQueryTime >= 0 && stats.totalNsecs() / 1000000 >= slowQueryTime) {
+            qCInfo(lcMdbTools) << "Slow query" << q->lastQuery() << stats;
+        } else {
+            qCDebug(lcMdbTools) << q->lastQuery() << stats;
+        }
+    }
+
     QSqlRecord recInf;
     QList<MdbColumn*> cols;
-    QList<QVariantList> data;
+    QSharedPointer<QMdbToolsRowStore> data;
+    QSharedPointer<QMdbToolsColumnStore> columns;  ///< typed values of a decoded page scan, replaces data
+    QSharedPointer<QMdbToolsSnapshot> snapshot;    ///< mapped sidecar of a snapshot scan, replaces data
+    QVector<int> snapshotColumns;                  ///< snapshot column of each result column
+    QVector<bool> snapshotShortDate;
+    QMdbToolsQueryStats stats;
+    qint64 pagesAtStart = 0;
+    qint64 shardPagesRead = 0;
+    qint64 resultBytes = 0;
+    QElapsedTimer timer;
 };
 
+/************************************************************/
+/// Returns true if the shard results a and b have the same columns in the same order
+static bool qSameColumns(const QSqlRecord &a, const QSqlRecord &b)
+{
+    if (a.count() != b.count())
+        return false;
+    for (int i = 0; i < a.count(); ++i) {
+        if (a.fieldName(i).compare(b.fieldName(i), Qt::CaseInsensitive) != 0
+                || a.field(i).typeID() != b.field(i).typeID())
+            return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Runs the query on every file of a sharded connection in parallel and
+/// concatenates the rows in file order. A last column tells the source file of each row.
+/// All shards must return the same columns, names and types, in the same order.
+bool QMdbToolsResultPrivate::fanOut(const QString &query)
+{
+    Q_Q(QMdbToolsResult);
+    const QStringList &files = drv_d_func()->shards;
+    QVector<QMdbToolsShardResult> results(files.size());
+    QAtomicInt stop;
+    QMdbToolsShardBudget budget;
+    budget.maxRows = drv_d_func()->maxRows;
+    budget.maxBytes = drv_d_func()->maxResultBytes;
+    // the shards share the memory budget, their rows beyond it are spilled to disk
+    const qint64 resultMemory = drv_d_func()->resultMemory;
+    const qint64 shardMemory = resultMemory > 0 ? qMax(Q_INT64_C(1), resultMemory / files.size()) : 0;
+
+    QThreadPool *pool = drv_d_func()->shardPool;
+    for (int i = 0; i < files.size(); ++i) {
+        results[i].file = files.at(i);
+        results[i].rows.reset(new QMdbToolsRowStore(shardMemory));
+        pool->start(new QMdbToolsShardTask(query, &stop, &budget, &results[i]));
+    }
+
+    const int timeout = drv_d_func()->queryTimeout;
+    QSqlError error;
+    while (!pool->waitForDone(100)) {
+        if (isCancelRequested()) {
+            error = qMakeError(QString(), QString::fromUtf8("Query cancelled"),
+                               QSqlError::StatementError, -12);
+        } else if (timeout > 0 && timer.hasExpired(timeout)) {
+            error = qMakeError(QString::fromUtf8("Query exceeded %1 ms").arg(timeout),
+                               QString::fromUtf8("Query timeout"),
+                               QSqlError::StatementError, -13);
+        }
+        if (error.isValid()) {
+            stop.storeRelaxed(1);
+            pool->waitForDone();
+            return abort(error);
+        }
+    }
+    const qint64 mark = timer.nsecsElapsed();
+    stats.scanNsecs = mark;
+
+    switch (budget.exceeded.loadRelaxed()) {
+    case -14:
+        return abort(rowLimitError());
+    case -15:
+        return abort(memoryLimitError());
+    }
+
+    clearInfo();
+    for (const auto &result : results) {
+        stats.rowsScanned += result.stats.rowsScanned;
+        stats.bytesDecoded += result.stats.bytesDecoded;
+        stats.oleBytesRead += result.stats.oleBytesRead;
+        shardPagesRead += result.stats.pagesRead;
+        if (!result.error.isEmpty()) {
+            return abort(qMakeError(result.error,
+                                    QString::fromUtf8("Cannot run query on %1").arg(result.file),
+                                    QSqlError::StatementError, -11));
+        }
+        if (recInf.isEmpty()) {
+            recInf = result.record;
+            recInf.append(QSqlField(QString::fromLatin1("_source_file"), QVariant::String));
+        } else if (!qSameColumns(result.record, results.first().record)) {
+            return abort(qMakeError(QString::fromUtf8("Columns differ from %1").arg(results.first().file),
+                                    QString::fromUtf8("Cannot run query on %1").arg(result.file),
+                                    QSqlError::StatementError, -11));
+        }
+    }
+
+    resultBytes = 0;
+    for (const auto &result : results) {
+        QMdbToolsRowStore &rows = *result.rows;
+        for (int r = 0; r < rows.size(); ++r) {
+            const int count = rows.row(r).size();
+            QVariantList values;
+            values.reserve(count);
+            for (int c = 0; c < count; ++c)
+                values << rows.value(r, c);
+            if (!canAddRow() || !addRow(values))
+                return false;
+        }
+        rows.clear();
+    }
+    stats.decodeNsecs = timer.nsecsElapsed() - mark;
+
+    finishStats();
+    q->setActive(true);
+    q->setSelect(true);
+    return true;
+}
+
+/************************************************************/
+/// Serves the query from the result cache.
+/// \return false if the query is not cached
+bool QMdbToolsResultPrivate::fetchCached(const QString &key)
+{
+    Q_Q(QMdbToolsResult);
+    QMdbToolsResultCache::Entry entry;
+    if (!QMdbToolsResultCache::instance()->find(key, &entry))
+        return false;
+
+    clearInfo();
+    recInf = entry.record;
+    data = entry.rows;
+    columns = entry.columns;
+    resultBytes = entry.bytes;
+    stats.cacheHits = 1;
+    stats.rowsReturned = rowCount();
+
+    const int maxRows = drv_d_func()->maxRows;
+    const qint64 maxBytes = drv_d_func()->maxResultBytes;
+    if (maxRows > 0 && rowCount() > maxRows) {
+        abort(rowLimitError());
+        return true;
+    }
+    if (maxBytes > 0 && entry.bytes > maxBytes) {
+        abort(memoryLimitError());
+        return true;
+    }
+
+    finishStats();
+    q->setActive(true);
+    q->setSelect(true);
+    return true;
+}
+
+/************************************************************/
+/// Returns true if the query reads all rows of a table without a filter
+bool QMdbToolsResultPrivate::isPlainScan(MdbSQL *sql) const
+{
+    auto table = sql->cur_table;
+    if (!table || table->is_temp_table || table->sarg_tree || sql->sarg_tree)
+        return false;
+    return !cols.isEmpty();
+}
+
+/************************************************************/
+/// Unfiltered scans of fixed-width columns are decoded page by page.
+/// The decoded columns stay in memory, so a result with a memory budget is read row by row
+/// into the spilling row store instead.
+bool QMdbToolsResultPrivate::canScanPages(MdbSQL *sql) const
+{
+    if (drv_d_func()->resultMemory > 0 || !isPlainScan(sql))
+        return false;
+    for (auto col : cols) {
+        if (!QMdbToolsPageDecoder::canDecode(col))
+            return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Reads the data pages of the current table and decodes each one with QMdbToolsPageDecoder.
+/// The values stay in typed arrays, they are converted when the result is read.
+bool QMdbToolsResultPrivate::scanPages(qint64 &mark)
+{
+    auto mdb = handle();
+    auto table = access()->cur_table;
+    QMdbToolsPageDecoder decoder(mdb, cols);
+    QVector<bool> shortDate(cols.size());
+    for (int c = 0; c < cols.size(); ++c)
+        shortDate[c] = cols.at(c)->col_type == MDB_DATETIME && QMdbToolsPageDecoder::isShortDate(cols.at(c));
+    columns.reset(new QMdbToolsColumnStore(cols, shortDate));
+
+    mdb_rewind_table(table);
+    while (mdb_read_next_dpg(table)) {
+        if (!checkInterrupted())
+            return false;
+        const qint64 fetched = timer.nsecsElapsed();
+        stats.scanNsecs += fetched - mark;
+        const int rows = decoder.decodePage(mdb->pg_buf);
+        stats.rowsScanned += rows;
+        if (!addBatch(decoder.columns(), rows))
+            return false;
+        stats.bytesDecoded += decoder.bytesDecoded();
+        mark = timer.nsecsElapsed();
+        stats.decodeNsecs += mark - fetched;
+    }
+    stats.scanNsecs += timer.nsecsElapsed() - mark;
+    return true;
+}
+
+/************************************************************/
+/// Returns the snapshot that can serve the query, if snapshots are enabled
+QSharedPointer<QMdbToolsSnapshot> QMdbToolsResultPrivate::snapshotFor(MdbSQL *sql) const
+{
+    if (!drv_d_func()->snapshots || !isPlainScan(sql))
+        return QSharedPointer<QMdbToolsSnapshot>();
+    for (auto col : cols) {
+        if (!QMdbToolsSnapshot::canStore(handle(), col))
+            return QSharedPointer<QMdbToolsSnapshot>();
+    }
+    auto res = drv_d_func()->snapshot(QString::fromUtf8(sql->cur_table->name));
+    if (!res || res->rowCount() > INT_MAX)
+        return QSharedPointer<QMdbToolsSnapshot>();
+    for (auto col : cols) {
+        if (res->columnIndex(QString::fromUtf8(col->name)) < 0)
+            return QSharedPointer<QMdbToolsSnapshot>();
+    }
+    return res;
+}
+
+/************************************************************/
+/// Serves the rows of the query from the mapped snapshot instead of the database pages.
+/// Values are converted when the result is read, nothing is copied to the heap.
+bool QMdbToolsResultPrivate::scanSnapshot(const QSharedPointer<QMdbToolsSnapshot> &source, qint64 &mark)
+{
+    if (!checkInterrupted())
+        return false;
+    const int maxRows = drv_d_func()->maxRows;
+    const qint64 rows = source->rowCount();
+    if (maxRows > 0 && rows > maxRows)
+        return abort(rowLimitError());
+
+    snapshotColumns.resize(cols.size());
+    snapshotShortDate.resize(cols.size());
+    for (int c = 0; c < cols.size(); ++c) {
+        snapshotColumns[c] = source->columnIndex(QString::fromUtf8(cols.at(c)->name));
+        snapshotShortDate[c] = cols.at(c)->col_type == MDB_DATETIME && QMdbToolsPageDecoder::isShortDate(cols.at(c));
+    }
+    snapshot = source;
+    stats.rowsScanned += rows;
+    stats.rowsReturned += rows;
+    const qint64 now = timer.nsecsElapsed();
+    stats.decodeNsecs += now - mark;
+    mark = now;
+    return true;
+}
+
+/************************************************************/
+/// Returns the zone map for a filtered table scan, if zone maps are enabled
+QSharedPointer<QMdbToolsZoneMap> QMdbToolsResultPrivate::zoneMapFor(MdbSQL *sql) const
+{
+    auto table = sql->cur_table;
+    if (!drv_d_func()->zoneMaps || !table || table->is_temp_table)
+        return QSharedPointer<QMdbToolsZoneMap>();
+    if (!table->sarg_tree || table->strategy != MDB_TABLE_SCAN)
+        return QSharedPointer<QMdbToolsZoneMap>();
+    return drv_d_func()->zoneMap(table, &timer);
+}
+
+/************************************************************/
+/// Walks the usage map of the table and reads only the pages the zone map cannot rule out.
+/// Rows of the remaining pages are filtered by libmdb.
+bool QMdbToolsResultPrivate::scanZones(const QMdbToolsZoneMap &zoneMap, qint64 &mark)
+{
+    auto sql = access();
+    auto mdb = handle();
+    auto table = sql->cur_table;
+
+    QMdbToolsPageWalk walk(table);
+    while (walk.next()) {
+        if (!checkInterrupted())
+            return false;
+        if (!zoneMap.mayMatch(walk.page(), table->sarg_tree)) {
+            stats.pagesSkipped++;
+            continue;
+        }
+        if (!walk.read()) {
+            if (walk.status() == QMdbToolsPageWalk::ReadError)
+                break;
+            continue;
+        }
+
+        const int rows = mdb_get_int16(mdb->pg_buf, mdb->fmt->row_count_offset);
+        for (int r = 0; r < rows; ++r) {
+            stats.rowsScanned++;
+            if (!mdb_read_row(table, r))
+                continue;
+            const qint64 fetched = timer.nsecsElapsed();
+            stats.scanNsecs += fetched - mark;
+            if (!canAddRow())
+                return false;
+            QVariantList values;
+            values.reserve(sql->num_columns);
+            for (uint i = 0; i < sql->num_columns; ++i)
+                values << qGetValue(sql, cols.at(i), i, &stats);
+            if (!addRow(values))
+                return false;
+            mark = timer.nsecsElapsed();
+            stats.decodeNsecs += mark - fetched;
+        }
+    }
+    stats.scanNsecs += timer.nsecsElapsed() - mark;
+    return true;
+}
+
 /************************************************************/
 
 QMdbToolsResult::QMdbToolsResult(const QMdbToolsDriver *db)
@@ -288,15 +1164,15 @@ QVariant QMdbToolsResult::data(int index)
         return QVariant();
     }
 
-    auto rec = d->data.at(at());
+    const QVariant value = d->value(at(), index);
 
     const QSqlField info = d->recInf.field(index);
     switch (info.type()) {
     case QVariant::String:
-        return rec.at(index).toString();
+        return value.toString();
         break;
     default:
-        return rec.at(index).toString();
+        return value.toString();
         break;
     }
     return QVariant();
@@ -311,8 +1187,7 @@ bool QMdbToolsResult::isNull(int index)
         return true;
     if (!d->isFieldIdxInRange(index))
         return true;
-    auto rec = d->data.at(at());
-    return rec.at(index).isNull();
+    return d->isNullValue(at(), index);
 }
 
 /************************************************************/
@@ -324,54 +1199,93 @@ bool QMdbToolsResult::reset(const QString &query)
     setActive(false);
     setAt(QSql::BeforeFirstRow);
     d->clearData();
+    d->data->setMemoryBudget(d->drv_d_func()->resultMemory);
+    d->drv_d_func()->cancelRequested.storeRelaxed(0);
+    d->stats = QMdbToolsQueryStats();
+    d->pagesAtStart = d->drv_d_func()->pagesRead();
+    d->shardPagesRead = 0;
+
+    d->timer.start();
+
+    // the cache key covers one file, sharded results are not cached
+    if (d->drv_d_func()->shards.size() > 1)
+        return d->fanOut(query);
+
+    QString cacheKey;
+    if (d->drv_d_func()->resultCache) {
+        cacheKey = QMdbToolsResultCache::key(query, d->drv_d_func()->fileName,
+                                             QMdbToolsFileKey::fromStat(d->drv_d_func()->fileName));
+        if (d->fetchCached(cacheKey))
+            return isActive();
+    }
 
     auto sql = d->access();
-    mdb_sql_run_query(sql, const_cast<char *>(qUtf8Printable(query)));
+    qRunQuery(sql, query);
+    qint64 mark = d->timer.nsecsElapsed();
+    d->stats.parseNsecs = mark;
 
     if (mdb_sql_has_error(sql)) {
         setLastError(qMakeError(QString::fromLocal8Bit(sql->error_msg),
                                 QString::fromUtf8("Cannot run query"),
                                 QSqlError::StatementError, -11));
         mdb_sql_reset(sql);
+        d->finishStats();
         return false;
     }
 
     d->clearInfo();
     auto table = sql->cur_table;
-    for (uint i = 0; i < sql->num_columns; i++) {
-         MdbSQLColumn *sqlCol = static_cast<MdbSQLColumn *>(g_ptr_array_index(sql->columns, i));
-         MdbColumn *col = Q_NULLPTR;
-         for (uint j=0; j < table->num_cols; ++j) {
-             MdbColumn *tblCol = static_cast<MdbColumn*>(g_ptr_array_index(table->columns, j));
-             if (!g_ascii_strcasecmp(sqlCol->name, tblCol->name)) {
-                 col = tblCol;
-                 break;
-             }
-         }
-         d->cols << col;
-         if (col) {
-             auto fld = qMakeField(col);
-             d->recInf.append(fld);
-         } else {
-             QString colName   = QString::fromUtf8(sqlCol->name);
-             QString tableName = QString::fromUtf8(table->name);
-             QSqlField fld(colName, QVariant::String, tableName);
-             fld.setSqlType(MDB_TEXT);
-             fld.setReadOnly(true);
-             d->recInf.append(fld);
-         }
-    }
-
-    while(mdb_fetch_row(table)) {
-        QVariantList values;
-        for (uint i=0; i<sql->num_columns; ++i) {
-            MdbColumn *col = d->cols.at(i);
-            values << qGetValue(sql, col, i);
+    d->cols = qBindColumns(sql, &d->recInf);
+    d->stats.bindNsecs = d->timer.nsecsElapsed() - mark;
+    mark = d->timer.nsecsElapsed();
+
+    d->resultBytes = 0;
+
+    auto snapshot = d->snapshotFor(sql);
+    if (snapshot) {
+        if (!d->scanSnapshot(snapshot, mark))
+            return false;
+    } else if (auto zoneMap = d->zoneMapFor(sql)) {
+        if (!d->scanZones(*zoneMap, mark))
+            return false;
+    } else if (!d->checkInterrupted()) {
+        // cancelled or timed out while the zone map was built
+        return false;
+    } else if (d->canScanPages(sql)) {
+        if (!d->scanPages(mark))
+            return false;
+    } else {
+        QMdbToolsTableScan scan(table, &d->drv_d_func()->cancelRequested,
+                                &d->timer, d->drv_d_func()->queryTimeout);
+        while (scan.fetchRow()) {
+            const qint64 fetched = d->timer.nsecsElapsed();
+            d->stats.scanNsecs += fetched - mark;
+            d->stats.rowsScanned = scan.rowsScanned();
+            if (!d->canAddRow())
+                return false;
+            QVariantList values;
+            values.reserve(sql->num_columns);
+            for (uint i=0; i<sql->num_columns; ++i) {
+                MdbColumn *col = d->cols.at(i);
+                values << qGetValue(sql, col, i, &d->stats);
+            }
+            if (!d->addRow(values))
+                return false;
+            mark = d->timer.nsecsElapsed();
+            d->stats.decodeNsecs += mark - fetched;
         }
-        d->data << values;
+        d->stats.rowsScanned = scan.rowsScanned();
+        // reports the cancellation or the timeout that stopped the scan
+        if (scan.status() != QMdbToolsTableScan::Finished && !d->checkInterrupted())
+            return false;
+        d->stats.scanNsecs += d->timer.nsecsElapsed() - mark;
     }
 
     mdb_sql_reset(sql);
+    // snapshot results are read from the mapped file and not worth caching
+    if (!cacheKey.isEmpty() && !d->snapshot && !d->data->isSpilled())
+        QMdbToolsResultCache::instance()->insert(cacheKey, { d->recInf, d->data, d->columns, d->resultBytes });
+    d->finishStats();
     setActive(true);
     setSelect(true);
 
@@ -418,7 +1332,7 @@ bool QMdbToolsResult::fetchLast()
 int QMdbToolsResult::size()
 {
     Q_D(QMdbToolsResult);
-    return d->data.size();
+    return d->rowCount();
 }
 
 /************************************************************/
@@ -482,23 +1396,48 @@ bool QMdbToolsDriver::hasFeature(DriverFeature f) const
     case DriverFeature::EventNotifications:
     case DriverFeature::FinishQuery:
     case DriverFeature::MultipleResultSets:
-    case DriverFeature::CancelQuery:
         return false;
+    case DriverFeature::CancelQuery:
+        return true;
     }
     return false;
 }
 
 /************************************************************/
 /// \brief Open a database connection on database db (file name).
-/// MdbTools have no user name, password, host, port or connection options. Just file names.
+/// MdbTools have no user name, password, host or port. Just file names.
+/// A ';' separated list of files or a wildcard pattern opens a sharded connection:
+/// queries run on all files in parallel, tables() and record() describe the first file.
+/// Supported connection options (separated by ';'):
+/// QMDBTOOLS_QUERY_TIMEOUT=msecs, QMDBTOOLS_MAX_ROWS=rows, QMDBTOOLS_MAX_RESULT_BYTES=bytes,
+/// QMDBTOOLS_RESULT_MEMORY_BYTES=bytes, QMDBTOOLS_SLOW_QUERY_MS=msecs,
+/// QMDBTOOLS_SNAPSHOTS=1, QMDBTOOLS_SNAPSHOT_DIR=path, QMDBTOOLS_ZONE_MAPS=1,
+/// QMDBTOOLS_RESULT_CACHE_BYTES=bytes
 /// \return return true on success and false on failure.
-bool QMdbToolsDriver::open(const QString &db, const QString &, const QString &, const QString &, int, const QString &)
+bool QMdbToolsDriver::open(const QString &db, const QString &, const QString &, const QString &, int, const QString &connOpts)
 {
     Q_D(QMdbToolsDriver);
     if (isOpen())
         close();
 
-    MdbHandle *handle = d->open(db);
+    d->setOptions(connOpts);
+
+    d->shards = QMdbToolsDriverPrivate::expandShards(db);
+    if (d->shards.isEmpty()) {
+        setLastError(qMakeError(QString(), tr("No database files match %1").arg(db),
+                     QSqlError::ConnectionError, -1));
+        setOpenError(true);
+        return false;
+    }
+    if (d->shards.size() > 1 && !d->shardPool)
+        d->shardPool = new QThreadPool;
+    if (d->snapshots && !d->snapshotPool) {
+        d->snapshotPool = new QThreadPool;
+        d->snapshotPool->setMaxThreadCount(1);
+    }
+    const QString file = d->shards.first();
+
+    MdbHandle *handle = d->open(file);
 
     if (d->hasError()) {
         setLastError(qMakeError(d->lastError(),
@@ -517,6 +1456,14 @@ bool QMdbToolsDriver::open(const QString &db, const QString &, const QString &,
         return false;
     }
 
+    /* count page reads for query statistics */
+    mdb_stats_on(handle);
+
+    d->fileName = file;
+    d->fileKey = (d->snapshots || d->zoneMaps) ? QMdbToolsFileKey::fromFile(file) : QMdbToolsFileKey();
+    d->snapshotCache.clear();
+    d->zoneMapCache.clear();
+
     setOpen(true);
     setOpenError(false);
     return true;
@@ -528,6 +1475,9 @@ void QMdbToolsDriver::close()
 {
     Q_D(QMdbToolsDriver);
     if (isOpen()) {
+        d->stopSnapshotBuilds();
+        d->snapshotCache.clear();
+        d->zoneMapCache.clear();
         d->close();
         if (d->hasError()) {
             setLastError(qMakeError(d->lastError(), tr("Error closing database"),
@@ -637,6 +1587,450 @@ QSqlIndex QMdbToolsDriver::primaryIndex(const QString &tblname) const
     return QSqlIndex();
 }
 
+/************************************************************/
+/// Requests cancellation of the running query. Safe to call from another thread.
+/// The scan stops before the next row and the query fails with error code -12.
+bool QMdbToolsDriver::cancelQuery()
+{
+    Q_D(QMdbToolsDriver);
+    d->cancelRequested.storeRelaxed(1);
+    return true;
+}
+
+/************************************************************/
+/// Sets the max wall time of subsequent queries in msecs (0 means no limit).
+void QMdbToolsDriver::setQueryTimeout(int msecs)
+{
+    d_func()->queryTimeout = qMax(0, msecs);
+}
+
+/************************************************************/
+
+int QMdbToolsDriver::queryTimeout() const
+{
+    return d_func()->queryTimeout;
+}
+
+/************************************************************/
+/// Sets the max number of rows of subsequent queries (0 means no limit).
+void QMdbToolsDriver::setMaxRows(int rows)
+{
+    d_func()->maxRows = qMax(0, rows);
+}
+
+/************************************************************/
+
+int QMdbToolsDriver::maxRows() const
+{
+    return d_func()->maxRows;
+}
+
+/************************************************************/
+/// Sets the max materialized size of subsequent results in bytes (0 means no limit).
+void QMdbToolsDriver::setMaxResultBytes(qint64 bytes)
+{
+    d_func()->maxResultBytes = qMax(Q_INT64_C(0), bytes);
+}
+
+/************************************************************/
+
+qint64 QMdbToolsDriver::maxResultBytes() const
+{
+    return d_func()->maxResultBytes;
+}
+
+/************************************************************/
+/// Sets the memory kept by a result before its rows are spilled to a temporary file (0 means no limit).
+void QMdbToolsDriver::setResultMemoryBudget(qint64 bytes)
+{
+    d_func()->resultMemory = qMax(Q_INT64_C(0), bytes);
+}
+
+/************************************************************/
+
+qint64 QMdbToolsDriver::resultMemoryBudget() const
+{
+    return d_func()->resultMemory;
+}
+
+/************************************************************/
+/// Returns the execution counters of the last query run on this connection.
+QMdbToolsQueryStats QMdbToolsDriver::lastQueryStats() const
+{
+    return d_func()->lastStats;
+}
+
+/************************************************************/
+/// Writes all rows of table to fileName without materializing a result.
+/// CsvExport writes RFC 4180 CSV with a header line, ArrowExport an Arrow IPC stream.
+/// The export can be cancelled with cancelQuery(); failures have error code -16.
+bool QMdbToolsDriver::exportTable(const QString &table, const QString &fileName, ExportFormat format)
+{
+    Q_D(QMdbToolsDriver);
+    if (!isOpen())
+        return false;
+
+    d->cancelRequested.storeRelaxed(0);
+    QString error;
+    if (!QMdbToolsExporter::exportTable(d->access->mdb, table, fileName,
+                                        QMdbToolsExporter::Format(format), &d->cancelRequested, &error)) {
+        setLastError(qMakeError(error, tr("Cannot export table %1").arg(table),
+                                QSqlError::StatementError, -16));
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Exports tables into dirName, one file <table>.csv or <table>.arrows per table.
+/// Tables are exported in parallel, each with its own handle on the database file.
+bool QMdbToolsDriver::exportTables(const QStringList &tables, const QString &dirName, ExportFormat format)
+{
+    Q_D(QMdbToolsDriver);
+    if (!isOpen())
+        return false;
+
+    d->cancelRequested.storeRelaxed(0);
+    QStringList errors;
+    if (!QMdbToolsExporter::exportTables(d->fileName, tables, dirName, QMdbToolsExporter::Format(format),
+                                         &d->cancelRequested, &errors)) {
+        setLastError(qMakeError(errors.join(QLatin1Char('\n')), tr("Cannot export tables"),
+                                QSqlError::StatementError, -16));
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Writes the rows of query to fileName like exportTable() does
+bool QMdbToolsDriver::exportQuery(const QString &query, const QString &fileName, ExportFormat format)
+{
+    Q_D(QMdbToolsDriver);
+    if (!isOpen())
+        return false;
+
+    d->cancelRequested.storeRelaxed(0);
+    auto sql = d->access;
+    qRunQuery(sql, query);
+    if (mdb_sql_has_error(sql)) {
+        setLastError(qMakeError(QString::fromLocal8Bit(sql->error_msg),
+                                QString::fromUtf8("Cannot run query"),
+                                QSqlError::StatementError, -11));
+        mdb_sql_reset(sql);
+        return false;
+    }
+
+    QSqlRecord rec;
+    const QList<MdbColumn*> cols = qBindColumns(sql, &rec);
+    // the exporter reads the values from the page, only OLE values need a bound buffer
+    for (MdbColumn *col : cols) {
+        if (col && col->col_type != MDB_OLE) {
+            col->bind_ptr = Q_NULLPTR;
+            col->len_ptr  = Q_NULLPTR;
+        }
+    }
+    QString error;
+    bool ok = false;
+    if (cols.contains(Q_NULLPTR)) {
+        error = QString::fromUtf8("Query has columns not found in table");
+    } else {
+        QMdbToolsExporter exporter(sql->mdb, sql->cur_table, cols, QMdbToolsExporter::Format(format));
+        ok = exporter.run(fileName, &d->cancelRequested, &error);
+    }
+    mdb_sql_reset(sql);
+    if (!ok) {
+        setLastError(qMakeError(error, tr("Cannot export query"), QSqlError::StatementError, -16));
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Returns the column indexes of the primary key of table, empty if it has none
+static QVector<int> qPrimaryKeyColumns(MdbTableDef *table)
+{
+    QVector<int> res;
+    mdb_read_indices(table);
+    for (uint i = 0; i < table->num_idxs; i++) {
+        MdbIndex *idx = static_cast<MdbIndex *>(g_ptr_array_index(table->indices, i));
+        if (idx->index_type != 1)
+            continue;
+        for (int k = 0; k < idx->num_keys; ++k)
+            res << idx->key_col_num[k] - 1;
+        break;
+    }
+    return res;
+}
+
+/************************************************************/
+/// Reports the rows of table inserted, changed or removed since the previous sync.
+/// The page fingerprints of the previous sync are read from stateFile and replaced by the
+/// current ones. Only data pages whose checksum changed are decoded; the whole scan is
+/// skipped when size, time and header of the database file are unchanged.
+/// Rows are matched by primary key, or by page and row slot if the table has none.
+/// A row moved to another slot without changes is not reported; without a primary key
+/// it is recognized by its content hash, so a moved and changed row is reported as
+/// removed and inserted. The first sync of a table reports all rows as inserted.
+/// Several tables may share one stateFile.
+bool QMdbToolsDriver::syncTable(const QString &tableName, const QString &stateFile,
+                                QVector<QMdbToolsRowChange> *changes)
+{
+    Q_D(QMdbToolsDriver);
+    if (!changes) {
+        setLastError(qMakeError(QString(), tr("No list for the changes of %1").arg(tableName),
+                                QSqlError::StatementError, -17));
+        return false;
+    }
+    changes->clear();
+    if (!isOpen())
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    QMdbToolsQueryStats stats;
+    const qint64 pagesAtStart = d->pagesRead();
+
+    QMdbToolsTableFingerprint previous;
+    const auto loaded = previous.load(stateFile, tableName);
+    if (loaded == QMdbToolsTableFingerprint::Invalid) {
+        setLastError(qMakeError(QString(), tr("Cannot read page fingerprints from %1").arg(stateFile),
+                                QSqlError::StatementError, -17));
+        return false;
+    }
+    const bool hasPrevious = loaded == QMdbToolsTableFingerprint::Loaded;
+    QMdbToolsTableFingerprint current;
+    current.fileKey = QMdbToolsFileKey::fromFile(d->fileName);
+    if (hasPrevious && current.fileKey.isValid() && current.fileKey == previous.fileKey) {
+        stats.scanNsecs = timer.nsecsElapsed();
+        d->lastStats = stats;
+        return true;
+    }
+
+    auto mdb = d->handle();
+    auto table = mdb_read_table_by_name(mdb, const_cast<char *>(qUtf8Printable(tableName)), MDB_TABLE);
+    if (!table) {
+        setLastError(qMakeError(QString(), tr("Table %1 does not exist").arg(tableName),
+                                QSqlError::StatementError, -17));
+        return false;
+    }
+    mdb_read_columns(table);
+    const QVector<int> keyCols = qPrimaryKeyColumns(table);
+
+    // Jet4 text is decoded from the page, everything else is converted by libmdb
+    QList<MdbColumn*> cols;
+    QVector<QByteArray> bindBuffers;
+    bindBuffers.reserve(int(table->num_cols));
+    for (uint i = 0; i < table->num_cols; i++) {
+        MdbColumn *col = static_cast<MdbColumn *>(g_ptr_array_index(table->columns, i));
+        cols << col;
+        if (!qIsDirectText(mdb, col) && !QMdbToolsPageDecoder::canDecode(col)) {
+            bindBuffers.append(QByteArray(MDB_BIND_SIZE, '\0'));
+            mdb_bind_column(table, int(i) + 1, bindBuffers.last().data(), Q_NULLPTR);
+        }
+    }
+
+    struct RowVersion {
+        quint32 page;
+        int row;
+        quint64 hash;
+        QVariantList key;
+        QVariantList values;
+    };
+    QVector<RowVersion> removed;
+    QVector<RowVersion> inserted;
+    auto keyOf = [&keyCols](const QVariantList &values) {
+        QVariantList key;
+        for (int c : keyCols)
+            key << values.value(c);
+        return key;
+    };
+
+    QMdbToolsPageWalk walk(table);
+    while (walk.nextDataPage()) {
+        const quint32 pg = walk.page();
+        QMdbToolsTableFingerprint::Page page;
+        page.checksum = QMdbToolsTableFingerprint::hash(mdb->pg_buf, mdb->fmt->pg_size);
+        auto old = previous.pages.constFind(pg);
+        const bool hasOld = old != previous.pages.constEnd();
+        if (hasOld && old->checksum == page.checksum) {
+            current.pages.insert(pg, *old);
+            stats.pagesSkipped++;
+            continue;
+        }
+
+        page.rowHashes = QMdbToolsTableFingerprint::rowHashes(mdb, mdb->pg_buf);
+        const int rows = page.rowHashes.size();
+        const int oldRows = hasOld ? old->rowHashes.size() : 0;
+        if (!keyCols.isEmpty())
+            page.keys.resize(rows);
+        for (int r = 0; r < qMax(rows, oldRows); ++r) {
+            const quint64 oldHash = r < oldRows ? old->rowHashes.at(r) : 0;
+            const quint64 newHash = r < rows ? page.rowHashes.at(r) : 0;
+            if (newHash == oldHash) {
+                if (newHash && !keyCols.isEmpty())
+                    page.keys[r] = old->keys.value(r);
+                continue;
+            }
+            if (oldHash)
+                removed.append({ pg, r, oldHash, old->keys.value(r), QVariantList() });
+            if (newHash)
+                stats.rowsScanned++;
+            if (newHash && mdb_read_row(table, r)) {
+                QVariantList values;
+                values.reserve(cols.size());
+                for (auto col : cols)
+                    values << qGetColumnValue(mdb, col, &stats);
+                const QVariantList key = keyOf(values);
+                if (!keyCols.isEmpty())
+                    page.keys[r] = key;
+                inserted.append({ pg, r, newHash, key, values });
+            }
+        }
+        current.pages.insert(pg, page);
+    }
+    mdb_free_tabledef(table);
+    if (walk.status() != QMdbToolsPageWalk::Finished) {
+        setLastError(qMakeError(QString(), tr("Cannot read table %1").arg(tableName),
+                                QSqlError::StatementError, -17));
+        return false;
+    }
+
+    // pages no longer used by the table
+    for (auto it = previous.pages.constBegin(); it != previous.pages.constEnd(); ++it) {
+        if (current.pages.contains(it.key()))
+            continue;
+        for (int r = 0; r < it->rowHashes.size(); ++r) {
+            if (it->rowHashes.at(r))
+                removed.append({ it.key(), r, it->rowHashes.at(r), it->keys.value(r), QVariantList() });
+        }
+    }
+
+    // a removed and an inserted version of the same row make a change
+    auto matchKey = [&keyCols](const RowVersion &version) {
+        QByteArray res;
+        QDataStream out(&res, QIODevice::WriteOnly);
+        if (keyCols.isEmpty())
+            out << version.page << qint32(version.row);
+        else
+            out << version.key;
+        return res;
+    };
+    QHash<QByteArray, int> removedIndex;
+    for (int i = 0; i < removed.size(); ++i)
+        removedIndex.insert(matchKey(removed.at(i)), i);
+    enum Match { Unmatched, Moved, Changed };
+    QVector<bool> matched(removed.size(), false);
+    QVector<Match> insertedMatch(inserted.size(), Unmatched);
+    for (int i = 0; i < inserted.size(); ++i) {
+        auto it = removedIndex.constFind(matchKey(inserted.at(i)));
+        if (it == removedIndex.constEnd() || matched.at(it.value()))
+            continue;
+        matched[it.value()] = true;
+        // moved to another slot without changes
+        insertedMatch[i] = removed.at(it.value()).hash == inserted.at(i).hash ? Moved : Changed;
+    }
+    // without a primary key a row moved to another slot is found by its content
+    if (keyCols.isEmpty()) {
+        QMultiHash<quint64, int> removedByHash;
+        for (int i = 0; i < removed.size(); ++i) {
+            if (!matched.at(i))
+                removedByHash.insert(removed.at(i).hash, i);
+        }
+        for (int i = 0; i < inserted.size() && !removedByHash.isEmpty(); ++i) {
+            if (insertedMatch.at(i) != Unmatched)
+                continue;
+            auto it = removedByHash.find(inserted.at(i).hash);
+            if (it == removedByHash.end())
+                continue;
+            matched[it.value()] = true;
+            insertedMatch[i] = Moved;
+            removedByHash.erase(it);
+        }
+    }
+    for (int i = 0; i < inserted.size(); ++i) {
+        if (insertedMatch.at(i) == Moved)
+            continue;
+        const RowVersion &version = inserted.at(i);
+        QMdbToolsRowChange change;
+        change.type = insertedMatch.at(i) == Changed ? QMdbToolsRowChange::Changed
+                                                     : QMdbToolsRowChange::Inserted;
+        change.page = version.page;
+        change.row = version.row;
+        change.key = version.key;
+        change.values = version.values;
+        changes->append(change);
+    }
+    for (int i = 0; i < removed.size(); ++i) {
+        if (matched.at(i))
+            continue;
+        QMdbToolsRowChange change;
+        change.type = QMdbToolsRowChange::Removed;
+        change.page = removed.at(i).page;
+        change.row = removed.at(i).row;
+        change.key = removed.at(i).key;
+        changes->append(change);
+    }
+
+    stats.pagesRead = d->pagesRead() - pagesAtStart;
+    stats.rowsReturned = changes->size();
+    stats.scanNsecs = timer.nsecsElapsed();
+    d->lastStats = stats;
+
+    if (!current.save(stateFile, tableName)) {
+        setLastError(qMakeError(QString(), tr("Cannot save page fingerprints to %1").arg(stateFile),
+                                QSqlError::StatementError, -17));
+        return false;
+    }
+    return true;
+}
+
+/************************************************************/
+/// Returns row, page and size counts of table without reading its data pages.
+/// If samplePages is positive, per column null fractions and distinct value estimates
+/// are computed from at most samplePages data pages spread over the table.
+QMdbToolsTableStats QMdbToolsDriver::tableStats(const QString &tbl, int samplePages) const
+{
+    auto mdb = d_func()->handle();
+
+    if (!isOpen())
+        return QMdbToolsTableStats();
+
+    QString tableName = tbl;
+    if (isIdentifierEscaped(tableName, QSqlDriver::TableName))
+        tableName = stripDelimiters(tableName, QSqlDriver::TableName);
+
+    auto table = mdb_read_table_by_name(mdb, const_cast<char *>(qUtf8Printable(tableName)), MDB_TABLE);
+    if (!table) {
+        qDebug() << QString::fromLocal8Bit("Error: Table %1 does not exist in this database.").arg(tableName);
+        return QMdbToolsTableStats();
+    }
+    mdb_read_columns(table);
+
+    QMdbToolsTableStatsCollector collector(mdb, table);
+    const QMdbToolsTableStats res = collector.collect(samplePages);
+    mdb_free_tabledef(table);
+    return res;
+}
+
+/************************************************************/
+
+QDebug operator<<(QDebug dbg, const QMdbToolsQueryStats &stats)
+{
+    QDebugStateSaver saver(dbg);
+    dbg.nospace() << "QMdbToolsQueryStats(pages " << stats.pagesRead
+                  << ", skipped " << stats.pagesSkipped
+                  << ", cache hits " << stats.cacheHits
+                  << ", scanned " << stats.rowsScanned
+                  << ", rows " << stats.rowsReturned
+                  << ", bytes " << stats.bytesDecoded
+                  << ", ole bytes " << stats.oleBytesRead
+                  << ", parse " << stats.parseNsecs / 1000 << "us"
+                  << ", bind " << stats.bindNsecs / 1000 << "us"
+                  << ", scan " << stats.scanNsecs / 1000 << "us"
+                  << ", decode " << stats.decodeNsecs / 1000 << "us)";
+    return dbg;
+}
+
 /************************************************************/
 
 QT_END_NAMESPACE
@@ -2,6 +2,8 @@
 #define QSQL_MDBTOOLS_H
 
 #include <QtSql/qsqldriver.h>
+#include <QtCore/qvariant.h>
+#include <QtCore/qvector.h>
 
 #ifdef QT_PLUGIN
 #define Q_EXPORT_SQLDRIVER_MDBTOOLS
@@ -11,6 +13,65 @@
 
 QT_BEGIN_NAMESPACE
 
+class QDebug;
+
+/// Execution counters collected by the driver for a single query
+struct QMdbToolsQueryStats
+{
+    qint64 pagesRead    = 0;  ///< pages read from the file
+    qint64 pagesSkipped = 0;  ///< data pages skipped by zone maps
+    qint64 cacheHits    = 0;  ///< results served from the result cache
+    qint64 rowsScanned  = 0;  ///< rows read from data pages, including rows the filter rejected
+    qint64 rowsReturned = 0;  ///< rows added to the result
+    qint64 bytesDecoded = 0;  ///< raw bytes of decoded cell values
+    qint64 oleBytesRead = 0;  ///< bytes read from OLE / long value pages
+    qint64 parseNsecs   = 0;  ///< time spent in SQL parsing
+    qint64 bindNsecs    = 0;  ///< time spent in binding result columns
+    qint64 scanNsecs    = 0;  ///< time spent in fetching rows
+    qint64 decodeNsecs  = 0;  ///< time spent in converting values
+
+    qint64 totalNsecs() const {
+        return parseNsecs + bindNsecs + scanNsecs + decodeNsecs;
+    }
+};
+
+Q_EXPORT_SQLDRIVER_MDBTOOLS QDebug operator<<(QDebug dbg, const QMdbToolsQueryStats &stats);
+
+/// A row that differs from the previous sync of a table, see QMdbToolsDriver::syncTable()
+struct QMdbToolsRowChange
+{
+    enum Type { Inserted, Changed, Removed };
+
+    Type type = Inserted;
+    quint32 page = 0;     ///< data page of the row, for removed rows as of the previous sync
+    int row = 0;          ///< row slot within the page
+    QVariantList key;     ///< primary key values, empty if the table has no primary key
+    QVariantList values;  ///< all column values, empty for removed rows
+};
+
+/// Estimates for one column of QMdbToolsTableStats, taken from the sampled rows
+struct QMdbToolsColumnStats
+{
+    QString name;
+    int type = 0;                 ///< libmdb column type
+    double nullFraction = 0;      ///< share of null values in the sample
+    qint64 distinctValues = 0;    ///< estimated number of distinct values in the table
+};
+
+/// Size and shape of a table, see QMdbToolsDriver::tableStats()
+struct QMdbToolsTableStats
+{
+    qint64 rowCount   = 0;        ///< rows according to the table definition
+    qint64 dataPages  = 0;        ///< pages in the usage map of the table
+    qint64 indexPages = 0;        ///< estimated from the number of rows and the key widths
+    qint64 diskBytes  = 0;        ///< bytes of the definition, data and index pages
+    double pageBytesPerRow = 0;   ///< bytes of the data pages per row, exact
+    double avgRowBytes = 0;       ///< value bytes per row estimated from the sample, 0 without a sample
+    int sampledPages  = 0;
+    int sampledRows   = 0;
+    QVector<QMdbToolsColumnStats> columns;  ///< empty without a sample
+};
+
 class QSqlResult;
 class QMdbToolsDriverPrivate;
 
@@ -37,8 +98,32 @@ public:
     QVariant handle() const override;
     QSqlRecord record(const QString& tablename) const override;
     QSqlIndex primaryIndex(const QString &table) const override;
+    bool cancelQuery() override;
+
+    void setQueryTimeout(int msecs);
+    int queryTimeout() const;
+    void setMaxRows(int rows);
+    int maxRows() const;
+    void setMaxResultBytes(qint64 bytes);
+    qint64 maxResultBytes() const;
+    void setResultMemoryBudget(qint64 bytes);
+    qint64 resultMemoryBudget() const;
+
+    QMdbToolsQueryStats lastQueryStats() const;
+
+    enum ExportFormat { CsvExport, ArrowExport };
+    bool exportTable(const QString &table, const QString &fileName, ExportFormat format = CsvExport);
+    bool exportTables(const QStringList &tables, const QString &dirName, ExportFormat format = CsvExport);
+    bool exportQuery(const QString &query, const QString &fileName, ExportFormat format = CsvExport);
+
+    bool syncTable(const QString &table, const QString &stateFile, QVector<QMdbToolsRowChange> *changes);
+
+    QMdbToolsTableStats tableStats(const QString &table, int samplePages = 16) const;
 };
 
 QT_END_NAMESPACE
 
+Q_DECLARE_METATYPE(QMdbToolsQueryStats)
+Q_DECLARE_METATYPE(QMdbToolsTableStats)
+
 #endif // QSQL_MDBTOOLS_H